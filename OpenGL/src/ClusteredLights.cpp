@@ -0,0 +1,74 @@
+#include "ClusteredLights.h"
+
+#include <algorithm>	// std::min
+#include <cassert>		// assert
+#include <cmath>		// std::log2
+
+namespace {
+	// average of lights per cluster index list has room for, clusters past it get no lights
+	constexpr U32 kAverageLightsPerCluster = 64;
+}
+
+ClusteredLights::ClusteredLights(U32 width, U32 height)
+	: m_passCull("lightCull.comp"), m_width(width), m_height(height)
+{
+	m_numTilesX = (width + kSizeTile - 1) / kSizeTile;
+	m_numTilesY = (height + kSizeTile - 1) / kSizeTile;
+	const U32 numClusters = m_numTilesX * m_numTilesY * kNumSlices;
+	m_capacityIndices = numClusters * kAverageLightsPerCluster;
+
+	glCreateBuffers(1, &m_bufLight);
+	glNamedBufferStorage(m_bufLight, kMaxLights * sizeof(Light), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glCreateBuffers(1, &m_bufCluster);
+	glNamedBufferStorage(m_bufCluster, numClusters * 2 * sizeof(U32), nullptr, 0);
+	glCreateBuffers(1, &m_bufIndex);
+	glNamedBufferStorage(m_bufIndex, m_capacityIndices * sizeof(U32), nullptr, 0);
+	glCreateBuffers(1, &m_bufCounter);
+	glNamedBufferStorage(m_bufCounter, sizeof(U32), nullptr, 0);
+}
+
+ClusteredLights::~ClusteredLights() {
+	glDeleteBuffers(1, &m_bufCounter);
+	glDeleteBuffers(1, &m_bufIndex);
+	glDeleteBuffers(1, &m_bufCluster);
+	glDeleteBuffers(1, &m_bufLight);
+}
+
+void ClusteredLights::SetLights(const std::vector<Light>& rALight) {
+	assert(rALight.size() <= kMaxLights);
+	m_numLights = U32(std::min(rALight.size(), Size(kMaxLights)));
+	if (m_numLights > 0)
+		glNamedBufferSubData(m_bufLight, 0, m_numLights * sizeof(Light), rALight.data());
+}
+
+void ClusteredLights::Cull(const Mat4& view, const Mat4& projection) {
+	const U32 zero = 0;
+	glClearNamedBufferData(m_bufCounter, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	m_passCull.Use();
+	m_passCull.SetMat4("View", view);
+	// view space x and y at depth d are (ndc + jitter) * d / scale
+	m_passCull.SetVec4("ProjParams", Vec4(1 / projection[0][0], 1 / projection[1][1], projection[2][0], projection[2][1]));
+	m_passCull.SetVec2("SizeScreen", Vec2(m_width, m_height));
+	m_passCull.SetUInt("NumLights", m_numLights);
+	m_passCull.SetUInt("CapacityIndices", m_capacityIndices);
+	Bind(m_passCull);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_bufCounter);
+	glDispatchCompute(m_numTilesX, m_numTilesY, kNumSlices);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void ClusteredLights::Bind(const Shader& shader) const {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBindingLights, m_bufLight);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBindingClusters, m_bufCluster);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBindingIndices, m_bufIndex);
+	// slice 0 < s < kNumSlices - 1 covers [near * ratio^(s - 1), near * ratio^s]
+	const F32 log2Ratio = std::log2(kVsFarSlices / kVsNearSlices) / (kNumSlices - 2);
+	shader.SetUInt("SizeTileCluster", kSizeTile);
+	shader.SetUInt("NumTilesXCluster", m_numTilesX);
+	shader.SetUInt("NumTilesYCluster", m_numTilesY);
+	shader.SetUInt("NumSlicesCluster", kNumSlices);
+	shader.SetFloat("VsNearSlices", kVsNearSlices);
+	shader.SetFloat("Log2RatioSlices", log2Ratio);
+}
\ No newline at end of file
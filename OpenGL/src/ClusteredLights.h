@@ -0,0 +1,62 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Shader.h"		// Shader
+
+#include <vector>		// std::vector
+
+// Point and spot lights culled into froxel grid: kSizeTile x kSizeTile pixel tiles of screen times kNumSlices
+// slices of view depth, first one up to kVsNearSlices, the rest exponential up to kVsFarSlices, the last one to infinity
+// (reversed-Z projection is infinite). Compute pass tests bounding sphere of every light against view space box
+// of every cluster and builds compact lists of light indices, shading then loops only over lights of pixel's cluster.
+class ClusteredLights
+{
+public:
+	static constexpr U32 kMaxLights = 4096;
+	static constexpr U32 kMaxLightsPerCluster = 256;	// shared list in lightCull.comp
+	static constexpr U32 kSizeTile = 64;
+	static constexpr U32 kNumSlices = 24;
+	static constexpr F32 kVsNearSlices = 1;
+	static constexpr F32 kVsFarSlices = 1000;
+	// shader storage bindings in lights.gl
+	static constexpr GLU kBindingLights = 0;
+	static constexpr GLU kBindingClusters = 1;
+	static constexpr GLU kBindingIndices = 2;
+
+	// std430 layout of Light in lights.gl
+	struct Light {
+		Vec3 m_wsPosition;
+		F32 m_radius;		// falls off to 0 there
+		Vec3 m_color;
+		F32 m_cosOuter;		// spot cone, below -1 for point light
+		Vec3 m_wsDirection;	// spot
+		F32 m_cosInner;
+	};
+
+	ClusteredLights(U32 width, U32 height);
+	~ClusteredLights();
+	ClusteredLights(const ClusteredLights&) = delete;
+	ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+	void SetLights(const std::vector<Light>& rALight);
+	U32 GetNumLights() const { return m_numLights; }
+
+	// projection can be jittered
+	void Cull(const Mat4& view, const Mat4& projection);
+	// binds lists for shading and sets uniforms of lights.gl
+	void Bind(const Shader& shader) const;
+
+private:
+	Shader m_passCull;
+	U32 m_width;
+	U32 m_height;
+	U32 m_numTilesX;
+	U32 m_numTilesY;
+	U32 m_numLights = 0;
+	U32 m_capacityIndices;
+	GLU m_bufLight = 0;
+	GLU m_bufCluster = 0;	// offset and count into m_bufIndex
+	GLU m_bufIndex = 0;
+	GLU m_bufCounter = 0;	// indices allocated by clusters
+};
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "DrawOrder.h"
+#include "Profiler.h"	// ProfileScope
+
+#include <algorithm>	// std::max, std::min
+#include <array>		// std::array
+#include <cassert>		// assert
+#include <cmath>		// std::log2
+#include <limits>		// std::numeric_limits
+
+namespace {
+	constexpr U32 kBitsMesh = 16;
+	constexpr U32 kBitsBucket = 6;
+	constexpr U32 kBitsMaterial = 16;
+	constexpr U32 kBitsDepthFine = 64 - kBitsBucket - kBitsMaterial - kBitsMesh;
+	constexpr U32 kBitsDepthOnly = 64 - kBitsMesh;
+
+	// perspective: log of distance, so relative precision is the same near and far
+	F32 GetDepthKey(const View& rView, const Mesh& rMesh) {
+		const F32 depth = rMesh.GetViewDepth(rView);
+		return rView.m_perspective ? std::log2(std::max(depth, 0.1f)) : depth;
+	}
+
+	U64 Quantize(F32 depth01, U32 bits) {
+		return U64(F64(std::min(std::max(depth01, 0.f), 1.f)) * F64((1ull << bits) - 1));
+	}
+}
+
+void DrawOrder::Sort(const View& rView, const std::vector<Mesh>& rAOpaque, const std::vector<Mesh>& rAMasked, Policy policy) {
+	ProfileScope profile("frame: sort draws");
+	assert(rAOpaque.size() <= kMaxMeshes && rAMasked.size() <= kMaxMeshes);
+	F32 depthMin = std::numeric_limits<F32>::max();
+	F32 depthMax = std::numeric_limits<F32>::lowest();
+	for (const std::vector<Mesh>* pAMesh : { &rAOpaque, &rAMasked }) {
+		for (const Mesh& rMesh : *pAMesh) {
+			const F32 depth = GetDepthKey(rView, rMesh);
+			depthMin = std::min(depthMin, depth);
+			depthMax = std::max(depthMax, depth);
+		}
+	}
+	const F32 depthScale = depthMax > depthMin ? 1 / (depthMax - depthMin) : 0;
+	SortMeshes(rView, rAOpaque, policy == Policy::CAMERA, depthMin, depthScale, m_aIdxOpaque);
+	SortMeshes(rView, rAMasked, true, depthMin, depthScale, m_aIdxMasked);
+}
+
+void DrawOrder::SortMeshes(const View& rView, const std::vector<Mesh>& rAMesh, Bool byMaterial, F32 depthMin, F32 depthScale, std::vector<U32>& rAIdx) {
+	m_aKey.resize(rAMesh.size());
+	for (U32 i = 0; i < rAMesh.size(); i++) {
+		const F32 depth01 = (GetDepthKey(rView, rAMesh[i]) - depthMin) * depthScale;
+		U64 key;
+		if (byMaterial) {
+			assert(rAMesh[i].GetMaterial() < kMaxMaterials);
+			key = Quantize(depth01, kBitsBucket) << (kBitsMaterial + kBitsDepthFine + kBitsMesh)
+				| U64(rAMesh[i].GetMaterial()) << (kBitsDepthFine + kBitsMesh)
+				| Quantize(depth01, kBitsDepthFine) << kBitsMesh;
+		} else {
+			key = Quantize(depth01, kBitsDepthOnly) << kBitsMesh;
+		}
+		m_aKey[i] = key | i;
+	}
+	RadixSort(m_aKey, m_aKeyTemp);
+	rAIdx.resize(m_aKey.size());
+	for (Size i = 0; i < m_aKey.size(); i++)
+		rAIdx[i] = U32(m_aKey[i] & ((1u << kBitsMesh) - 1));
+}
+
+void RadixSort(std::vector<U64>& rAKey, std::vector<U64>& rATemp) {
+	const Size numKeys = rAKey.size();
+	if (numKeys == 0)
+		return;
+	rATemp.resize(numKeys);
+	// histograms of all bytes in one read of keys
+	std::array<std::array<U32, 256>, 8> aCount = {};
+	for (U64 key : rAKey)
+		for (U32 b = 0; b < 8; b++)
+			aCount[b][(key >> (b * 8)) & 0xFF]++;
+
+	for (U32 b = 0; b < 8; b++) {
+		std::array<U32, 256>& rACount = aCount[b];
+		// keys keep their order when all of them have the same byte
+		if (rACount[(rAKey[0] >> (b * 8)) & 0xFF] == numKeys)
+			continue;
+		U32 offset = 0;
+		for (U32& rCount : rACount) {
+			const U32 count = rCount;
+			rCount = offset;
+			offset += count;
+		}
+		for (U64 key : rAKey)
+			rATemp[rACount[(key >> (b * 8)) & 0xFF]++] = key;
+		rAKey.swap(rATemp);
+	}
+}
\ No newline at end of file
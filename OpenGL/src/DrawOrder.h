@@ -0,0 +1,39 @@
+#pragma once
+#include "types.h"
+#include "Mesh.h"		// Mesh, View
+
+#include <vector>		// std::vector
+
+// Order in which Model draws meshes of one view, rebuilt every frame by radix sort of 64 bit keys,
+// index of mesh takes lowest 16 bits, depth is closest point of bounding sphere quantized over depth range of view:
+//   CAMERA  6 bit depth bucket | 16 bit material | 26 bit depth | 16 bit mesh
+//           front to back for early depth test, within each of 64 buckets draws of one material follow each other
+//   SHADOW  opaque as 48 bit depth | 16 bit mesh, positions only, so material doesn't matter,
+//           masked as CAMERA, they bind mask of their material
+// Perspective depth is quantized logarithmically, so buckets near eye are thinner.
+class DrawOrder
+{
+public:
+	enum class Policy : U32 { CAMERA, SHADOW };
+
+	static constexpr U32 kMaxMeshes = 1 << 16;
+	static constexpr U32 kMaxMaterials = 1 << 16;
+
+	void Sort(const View& rView, const std::vector<Mesh>& rAOpaque, const std::vector<Mesh>& rAMasked, Policy policy);
+
+	// indices of meshes in order of draws
+	const std::vector<U32>& GetOpaque() const { return m_aIdxOpaque; }
+	const std::vector<U32>& GetMasked() const { return m_aIdxMasked; }
+
+private:
+	void SortMeshes(const View& rView, const std::vector<Mesh>& rAMesh, Bool byMaterial, F32 depthMin, F32 depthScale, std::vector<U32>& rAIdx);
+
+	// reused every frame
+	std::vector<U64> m_aKey;
+	std::vector<U64> m_aKeyTemp;
+	std::vector<U32> m_aIdxOpaque;
+	std::vector<U32> m_aIdxMasked;
+};
+
+// ascending, least significant byte first, skips bytes which are the same in every key, rATemp is scratch memory
+void RadixSort(std::vector<U64>& rAKey, std::vector<U64>& rATemp);
\ No newline at end of file
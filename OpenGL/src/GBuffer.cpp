@@ -0,0 +1,139 @@
+#include "GBuffer.h"
+#include "StateCache.h"	// g_stateCache
+#include "error.h"		// PrintErrorAndAbort
+
+#include <iostream>		// std::cout
+
+namespace {
+	const char* GetName(GBuffer::Layout layout) {
+		switch (layout) {
+		case GBuffer::Layout::WIDE:			 return "wide";
+		case GBuffer::Layout::OCTAHEDRAL_16: return "octahedral 16";
+		case GBuffer::Layout::OCTAHEDRAL_8:	 return "octahedral 8";
+		default:							 return "?";
+		}
+	}
+
+	const char* GetName(GBuffer::Pass pass) {
+		switch (pass) {
+		case GBuffer::Pass::DEPTH_PREPASS:	 return "depth prepass";
+		case GBuffer::Pass::GEOMETRY:		 return "geometry (write)";
+		case GBuffer::Pass::VISIBILITY:		 return "visibility (write)";
+		case GBuffer::Pass::SHADOW_DEFERRED: return "deferred shadow (read)";
+		case GBuffer::Pass::SHADING:		 return "shading (read)";
+		case GBuffer::Pass::TAA:			 return "TAA (read)";
+		default:							 return "?";
+		}
+	}
+}
+
+GBuffer::GBuffer(U32 width, U32 height, Layout layout)
+	: m_width(width), m_height(height), m_layout(layout), m_timer(U32(Pass::COUNT)), m_layoutStats(layout)
+{
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_bufDiffuseSpec);
+	glTextureStorage2D(m_bufDiffuseSpec, 1, GL_RGBA8, width, height);
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_bufVelocity);
+	glTextureStorage2D(m_bufVelocity, 1, GL_RG16F, width, height);
+
+	const std::array<GLE, 3> aAttachment = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glCreateFramebuffers(1, &m_fbo);
+	glNamedFramebufferDrawBuffers(m_fbo, GLS(aAttachment.size()), aAttachment.data());
+	glNamedFramebufferTexture(m_fbo, GL_COLOR_ATTACHMENT0, m_bufDiffuseSpec, 0);
+	glNamedFramebufferTexture(m_fbo, GL_COLOR_ATTACHMENT2, m_bufVelocity, 0);
+	SetLayout(layout);
+
+	glCreateQueries(GL_SAMPLES_PASSED, GLS(m_aQuerySamples.size()), m_aQuerySamples.data());
+}
+
+GBuffer::~GBuffer() {
+	glDeleteQueries(GLS(m_aQuerySamples.size()), m_aQuerySamples.data());
+	glDeleteFramebuffers(1, &m_fbo);
+	g_stateCache.DeleteTexture(m_bufDiffuseSpec);
+	g_stateCache.DeleteTexture(m_bufNormal);
+	g_stateCache.DeleteTexture(m_bufVelocity);
+}
+
+void GBuffer::SetLayout(Layout layout) {
+	if (m_bufNormal != 0 && layout == m_layout)
+		return;
+	if (m_bufNormal != 0)
+		g_stateCache.DeleteTexture(m_bufNormal);
+	m_layout = layout;
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_bufNormal);
+	glTextureStorage2D(m_bufNormal, 1, GetFormatNormal(layout), m_width, m_height);
+	glNamedFramebufferTexture(m_fbo, GL_COLOR_ATTACHMENT1, m_bufNormal, 0);
+
+	if (glCheckNamedFramebufferStatus(m_fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		PrintErrorAndAbort("Framebuffer not complete!");
+}
+
+void GBuffer::Clear() const {
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear color as well, because I don't render skybox
+	glClearTexImage(m_bufVelocity, 0, GL_RG, GL_UNSIGNED_BYTE, nullptr);
+}
+
+void GBuffer::BeginPass(Pass pass) {
+	m_timer.BeginPass(U32(pass));
+	if (IsRasterizing(pass))
+		glBeginQuery(GL_SAMPLES_PASSED, m_aQuerySamples[m_timer.GetIdxFrame()]);
+}
+
+void GBuffer::EndPass(Pass pass) {
+	// samples end first, so once time is read back they are done and reading them in EndFrame() doesn't stall
+	if (IsRasterizing(pass))
+		glEndQuery(GL_SAMPLES_PASSED);
+	m_timer.EndPass(U32(pass));
+}
+
+void GBuffer::EndFrame() {
+	m_aLayoutIssued[m_timer.GetIdxFrame()] = m_layout;
+	m_timer.EndFrame([this](U32 idxPass) {
+		U64 samplesPassed = 0;
+		if (IsRasterizing(Pass(idxPass)))
+			glGetQueryObjectui64v(m_aQuerySamples[m_timer.GetIdxFrame()], GL_QUERY_RESULT, &samplesPassed);
+		return GetBytes(Pass(idxPass), m_aLayoutIssued[m_timer.GetIdxFrame()], samplesPassed);
+	});
+	m_layoutStats = m_aLayoutIssued[m_timer.GetIdxFrame()];
+}
+
+void GBuffer::PrintStats() const {
+	const Size bytesPerPixel = GetBytesPerPixel(GL_RGBA8) + GetBytesPerPixel(GetFormatNormal(m_layoutStats)) + GetBytesPerPixel(GL_RG16F);
+	std::cout << "G-buffer " << GetName(m_layoutStats) << ", " << bytesPerPixel << " B per pixel\n";
+	m_timer.PrintStats([](U32 idxPass) { return GetName(Pass(idxPass)); });
+}
+
+GLE GBuffer::GetFormatNormal(Layout layout) {
+	switch (layout) {
+	case Layout::OCTAHEDRAL_16: return GL_RG16;
+	case Layout::OCTAHEDRAL_8:	return GL_RG8;
+	default:					return GL_RGB10_A2; // not using A2
+	}
+}
+
+Size GBuffer::GetBytesPerPixel(GLE format) {
+	switch (format) {
+	case GL_RG8:  return 2;
+	default:	  return 4; // GL_RGBA8, GL_RGB10_A2, GL_RG16, GL_RG16F
+	}
+}
+
+Size GBuffer::GetBytes(Pass pass, Layout layout, U64 samplesPassed) const {
+	const Size bytesDiffuseSpec = GetBytesPerPixel(GL_RGBA8);
+	const Size bytesNormal = GetBytesPerPixel(GetFormatNormal(layout));
+	const Size bytesVelocity = GetBytesPerPixel(GL_RG16F);
+	const Size numPixels = Size(m_width) * m_height;
+	switch (pass) {
+	case Pass::GEOMETRY:		// every fragment which passed depth test, overdraw included (none after depth prepass)
+		return Size(samplesPassed) * (bytesDiffuseSpec + bytesNormal + bytesVelocity);
+	case Pass::VISIBILITY:		// ids of fragments, read by classification and material pass, which writes G-buffer once per pixel
+		return Size(samplesPassed) * sizeof(U32) + numPixels * (2 * sizeof(U32) + bytesDiffuseSpec + bytesNormal + bytesVelocity);
+	case Pass::SHADOW_DEFERRED:
+		return numPixels * bytesNormal;
+	case Pass::SHADING:
+		return numPixels * (bytesDiffuseSpec + bytesNormal);
+	case Pass::TAA:				// one fetch at closest depth of 3x3 neighbourhood
+		return numPixels * bytesVelocity;
+	default:
+		return 0;
+	}
+}
\ No newline at end of file
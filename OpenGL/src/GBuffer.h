@@ -0,0 +1,71 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "PassTimer.h"
+
+#include <array>		// std::array
+
+// Render targets of geometry pass (depth is attached by caller, it swaps with TAA history) in one of layouts:
+//   WIDE            RGBA8 diffuse + specular | RGB10A2 world normal * 0.5 + 0.5 | RG16F velocity, 12 B per pixel
+//   OCTAHEDRAL_16   RGBA8 diffuse + specular | RG16 octahedral normal           | RG16F velocity, 12 B per pixel
+//   OCTAHEDRAL_8    RGBA8 diffuse + specular | RG8 octahedral normal            | RG16F velocity, 10 B per pixel
+// Specular stays in alpha of diffuse target: 6 B of material and normal are already all OCTAHEDRAL_8 stores, moving
+// specular next to normal would leave alpha unused, RGB8 diffuse isn't required to be renderable.
+// Shaders pick encoding of normal by OctahedralNormals uniform (normals.gl), so switching layout at runtime
+// only recreates normal target. Velocity stays RG16F, TAA reprojects with it and less bits smear the history.
+// Also measures G-buffer traffic with PassTimer: GPU time of passes which write or read it and bytes they move
+// (written fragments of geometry or visibility buffer pass, full screen reads of the rest).
+// Depth prepass moves no G-buffer bytes, it's timed so geometry pass with and without it can be compared.
+class GBuffer
+{
+public:
+	enum class Layout : U32 { WIDE, OCTAHEDRAL_16, OCTAHEDRAL_8, COUNT };
+	enum class Pass : U32 { DEPTH_PREPASS, GEOMETRY, VISIBILITY, SHADOW_DEFERRED, SHADING, TAA, COUNT };
+
+	GBuffer(U32 width, U32 height, Layout layout);
+	~GBuffer();
+	GBuffer(const GBuffer&) = delete;
+	GBuffer& operator=(const GBuffer&) = delete;
+
+	void SetLayout(Layout layout);
+	Layout GetLayout() const { return m_layout; }
+	Bool IsOctahedral() const { return m_layout != Layout::WIDE; }
+	static GLE GetFormatNormal(Layout layout);
+
+	GLU GetFramebuffer() const { return m_fbo; }
+	GLU GetDiffuseSpec() const { return m_bufDiffuseSpec; }
+	GLU GetNormal() const { return m_bufNormal; }
+	GLU GetVelocity() const { return m_bufVelocity; }
+
+	// framebuffer has to be bound, also clears depth
+	void Clear() const;
+
+	// around work of pass, passes can't overlap
+	void BeginPass(Pass pass);
+	void EndPass(Pass pass);
+	// reads back queries of oldest frame
+	void EndFrame();
+	// time and traffic of passes from a few frames ago
+	void PrintStats() const;
+
+private:
+	static Size GetBytesPerPixel(GLE format);
+	// with samples passed query, only one of them runs per frame
+	static Bool IsRasterizing(Pass pass) { return pass == Pass::GEOMETRY || pass == Pass::VISIBILITY; }
+	// G-buffer bytes pass moves, samplesPassed only for geometry and visibility buffer pass
+	Size GetBytes(Pass pass, Layout layout, U64 samplesPassed) const;
+
+	U32 m_width;
+	U32 m_height;
+	Layout m_layout;
+	GLU m_fbo = 0;
+	GLU m_bufDiffuseSpec = 0;
+	GLU m_bufNormal = 0;
+	GLU m_bufVelocity = 0;
+
+	PassTimer m_timer;
+	std::array<GLU, PassTimer::kNumFramesQuery> m_aQuerySamples = {};
+	std::array<Layout, PassTimer::kNumFramesQuery> m_aLayoutIssued = {};	// layout can change before readback
+	Layout m_layoutStats;
+};
\ No newline at end of file
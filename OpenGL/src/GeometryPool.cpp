@@ -0,0 +1,146 @@
+#include "GeometryPool.h"
+#include "JobSystem.h"					// g_jobSystem
+
+#include <glm/gtc/packing.hpp>			// glm::packSnorm3x10_1x2, glm::packUnorm4x16
+#include <glm/packing.hpp>				// glm::packUnorm2x16
+
+#include <algorithm>					// std::max
+#include <cassert>						// assert
+#include <cstring>						// std::memcpy
+#include <limits>						// std::numeric_limits
+
+void PackVertices(const std::vector<Vertex>& rAVertex, const Quantization& rQuantization,
+				  VertexPosition* pPosition, VertexAttributes* pAttributes) {
+	// UVs are tiled with GL_REPEAT, so translation by integer doesn't change anything
+	// and keeps values small, which is crucial for precision
+	Vec2 uvMin(std::numeric_limits<F32>::max());
+	for (const Vertex& rVertex : rAVertex)
+		uvMin = glm::min(uvMin, rVertex.m_uv);
+	const Vec2 uvOffset = glm::floor(uvMin);
+
+	for (Size i = 0; i < rAVertex.size(); i++) {
+		const Vertex& rVertex = rAVertex[i];
+		const Vec3 position = (rVertex.m_position - rQuantization.m_posMin) / rQuantization.m_posExtent;
+		const U64 position4 = glm::packUnorm4x16(Vec4(position, 0));
+		std::memcpy(&pPosition[i].m_position[0], &position4, sizeof(position4));
+
+		VertexAttributes& rAttributes = pAttributes[i];
+		rAttributes.m_normal = glm::packSnorm3x10_1x2(Vec4(rVertex.m_normal, 0));
+		rAttributes.m_tangent = glm::packSnorm3x10_1x2(rVertex.m_tangent);
+		const U32 uv = glm::packUnorm2x16((rVertex.m_uv - uvOffset) / rQuantization.m_rangeUv);
+		std::memcpy(&rAttributes.m_uv[0], &uv, sizeof(uv));
+	}
+}
+
+GeometryPool::Range GeometryPool::Add(const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex, const Quantization& rQuantization) {
+	assert(m_IBO == 0 && "Add() after Upload()");
+	const Range range = { U32(m_numVertices), U32(m_numIndices) };
+	m_aPendingMesh.push_back({ rAVertex, rAIndex, rQuantization, range });
+	m_numVertices += rAVertex.size();
+	m_numIndices += rAIndex.size();
+	m_maxNumVerticesMesh = std::max(m_maxNumVerticesMesh, rAVertex.size());
+	return range;
+}
+
+void GeometryPool::Upload(UploadManager& rUploadManager) {
+	m_indexType = m_maxNumVerticesMesh <= Size(std::numeric_limits<U16>::max()) + 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	glCreateBuffers(1, &m_VBOPosition);
+	glCreateBuffers(1, &m_VBOAttributes);
+	glCreateBuffers(1, &m_IBO);
+
+	glNamedBufferStorage(m_VBOPosition, std::max<Size>(m_numVertices, 1) * sizeof(VertexPosition), nullptr, 0);
+	glNamedBufferStorage(m_VBOAttributes, std::max<Size>(m_numVertices, 1) * sizeof(VertexAttributes), nullptr, 0);
+	// compute passes read indices as uints, so keep whole last uint in buffer
+	const Size sizeIndices = (std::max<Size>(m_numIndices, 1) * GetIndexSize() + sizeof(U32) - 1) / sizeof(U32) * sizeof(U32);
+	glNamedBufferStorage(m_IBO, sizeIndices, nullptr, 0);
+	glClearNamedBufferData(m_IBO, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	// in batches of meshes which fit into staging memory together
+	for (Size idxFirst = 0; idxFirst < m_aPendingMesh.size();) {
+		std::vector<UploadManager::Allocation> aAllocation;
+		Size idxEnd = idxFirst;
+		while (idxEnd < m_aPendingMesh.size()) {
+			const Size sizeStaging = GetSizeStaging(m_aPendingMesh[idxEnd]);
+			UploadManager::Allocation allocation;
+			if (idxEnd == idxFirst)
+				allocation = rUploadManager.Allocate(sizeStaging);
+			else if (!rUploadManager.TryAllocate(sizeStaging, allocation))
+				break;
+			aAllocation.push_back(allocation);
+			idxEnd++;
+		}
+		g_jobSystem.ParallelFor("load: pack mesh", U32(idxEnd - idxFirst), 1, [&](U32 first, U32 end) {
+			for (U32 i = first; i < end; i++)
+				PackMesh(m_aPendingMesh[idxFirst + i], rUploadManager, aAllocation[i]);
+		});
+		rUploadManager.Flush();
+		idxFirst = idxEnd;
+	}
+
+	m_VAO = CreateVertexArray(m_IBO, false);
+	// separate VAO instead of relying on driver to skip enabled attributes unused by shader
+	m_VAOPosition = CreateVertexArray(m_IBO, true);
+
+	m_aPendingMesh = std::vector<PendingMesh>();
+}
+
+Size GeometryPool::GetSizeStaging(const PendingMesh& rMesh) const {
+	return rMesh.m_aVertex.size() * (sizeof(VertexPosition) + sizeof(VertexAttributes)) + rMesh.m_aIndex.size() * GetIndexSize();
+}
+
+void GeometryPool::PackMesh(const PendingMesh& rMesh, UploadManager& rUploadManager, const UploadManager::Allocation& rAllocation) const {
+	// positions, attributes and indices one after another, all of them stay 4 byte aligned
+	const Size numVertices = rMesh.m_aVertex.size();
+	const Size sizePositions = numVertices * sizeof(VertexPosition);
+	const Size sizeAttributes = numVertices * sizeof(VertexAttributes);
+	const Size sizeIndices = rMesh.m_aIndex.size() * GetIndexSize();
+	U8* pPositions = rAllocation.m_pData;
+	U8* pAttributes = pPositions + sizePositions;
+	U8* pIndices = pAttributes + sizeAttributes;
+
+	PackVertices(rMesh.m_aVertex, rMesh.m_quantization, reinterpret_cast<VertexPosition*>(pPositions), reinterpret_cast<VertexAttributes*>(pAttributes));
+	if (m_indexType == GL_UNSIGNED_SHORT) {
+		U16* pIndex16 = reinterpret_cast<U16*>(pIndices);
+		for (Size i = 0; i < rMesh.m_aIndex.size(); i++)
+			pIndex16[i] = U16(rMesh.m_aIndex[i]);
+	} else {
+		std::memcpy(pIndices, rMesh.m_aIndex.data(), sizeIndices);
+	}
+
+	const Range& rRange = rMesh.m_range;
+	rUploadManager.Commit(rAllocation, {
+		UploadManager::CopyToBuffer(m_VBOPosition, rRange.m_baseVertex * sizeof(VertexPosition), 0, sizePositions),
+		UploadManager::CopyToBuffer(m_VBOAttributes, rRange.m_baseVertex * sizeof(VertexAttributes), sizePositions, sizeAttributes),
+		UploadManager::CopyToBuffer(m_IBO, rRange.m_firstIndex * GetIndexSize(), sizePositions + sizeAttributes, sizeIndices)
+	});
+}
+
+GLU GeometryPool::CreateVertexArray(GLU indexBuffer, Bool positionOnly) const {
+	// binding 0: position, binding 1: everything else
+	GLU vao;
+	glCreateVertexArrays(1, &vao);
+	glVertexArrayElementBuffer(vao, indexBuffer);
+
+	glVertexArrayVertexBuffer(vao, 0, m_VBOPosition, 0, sizeof(VertexPosition));
+	glEnableVertexArrayAttrib(vao, 0);
+	glVertexArrayAttribFormat(vao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(VertexPosition, m_position));
+	glVertexArrayAttribBinding(vao, 0, 0);
+	if (positionOnly)
+		return vao;
+
+	glVertexArrayVertexBuffer(vao, 1, m_VBOAttributes, 0, sizeof(VertexAttributes));
+
+	glEnableVertexArrayAttrib(vao, 1);
+	glEnableVertexArrayAttrib(vao, 2);
+	glEnableVertexArrayAttrib(vao, 3);
+
+	glVertexArrayAttribFormat(vao, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(VertexAttributes, m_normal));
+	glVertexArrayAttribFormat(vao, 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(VertexAttributes, m_uv));
+	glVertexArrayAttribFormat(vao, 3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(VertexAttributes, m_tangent));
+
+	glVertexArrayAttribBinding(vao, 1, 1);
+	glVertexArrayAttribBinding(vao, 2, 1);
+	glVertexArrayAttribBinding(vao, 3, 1);
+	return vao;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Mesh.h"		// Vertex, VertexPosition, VertexAttributes, Quantization
+#include "UploadManager.h"	// UploadManager
+
+#include <vector>		// std::vector
+
+// Vertices and indices of all meshes of a model in shared buffers, so meshes differ only by offsets,
+// all draws go through the same VAO and compute passes can read any mesh.
+class GeometryPool
+{
+public:
+	struct Range {
+		U32 m_baseVertex;
+		U32 m_firstIndex;
+	};
+
+	// appends mesh, indices stay relative to mesh (base vertex is applied by draw)
+	Range Add(const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex, const Quantization& rQuantization);
+	// creates OGL objects, meshes are packed by jobs straight into staging memory and copied by GPU,
+	// releases CPU copies, no Add() afterwards
+	void Upload(UploadManager& rUploadManager);
+
+	// index buffer is 16 bit when every mesh has at most 65536 vertices
+	GLE GetIndexType() const { return m_indexType; }
+	Size GetIndexSize() const { return m_indexType == GL_UNSIGNED_SHORT ? sizeof(U16) : sizeof(U32); }
+	GLU GetIndexBuffer() const { return m_IBO; }
+	// for compute passes which fetch vertices themselves
+	GLU GetPositionBuffer() const { return m_VBOPosition; }
+	GLU GetAttributesBuffer() const { return m_VBOAttributes; }
+	GLU GetVAO() const { return m_VAO; }
+	GLU GetVAOPosition() const { return m_VAOPosition; }
+
+	// both (or only position) vertex streams, with any index buffer
+	GLU CreateVertexArray(GLU indexBuffer, Bool positionOnly) const;
+
+private:
+	struct PendingMesh {
+		std::vector<Vertex> m_aVertex;
+		std::vector<U32> m_aIndex;
+		Quantization m_quantization;
+		Range m_range;
+	};
+
+	Size GetSizeStaging(const PendingMesh& rMesh) const;
+	// job, writes vertices and indices into staging memory and commits copies of them
+	void PackMesh(const PendingMesh& rMesh, UploadManager& rUploadManager, const UploadManager::Allocation& rAllocation) const;
+
+	std::vector<PendingMesh> m_aPendingMesh;
+	Size m_numVertices = 0;
+	Size m_numIndices = 0;
+	Size m_maxNumVerticesMesh = 0;
+
+	GLE m_indexType = GL_UNSIGNED_INT;
+	GLU m_VBOPosition = 0;
+	GLU m_VBOAttributes = 0;
+	GLU m_IBO = 0;
+	GLU m_VAO = 0;			// both streams
+	GLU m_VAOPosition = 0;	// position stream only
+};
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "GtaoBuffer.h"
+#include "StateCache.h"	// g_stateCache
+
+#include <iostream>		// std::cout
+
+namespace {
+	const char* GetName(GtaoBuffer::Layout layout) {
+		switch (layout) {
+		case GtaoBuffer::Layout::SCALAR:		return "scalar R8";
+		case GtaoBuffer::Layout::BENT_RGBA8:	return "bent normal RGBA8";
+		case GtaoBuffer::Layout::BENT_RGB10A2:	return "bent normal RGB10A2";
+		default:								return "?";
+		}
+	}
+
+	const char* GetName(GtaoBuffer::Pass pass) {
+		switch (pass) {
+		case GtaoBuffer::Pass::MAIN:				return "GTAO (write)";
+		case GtaoBuffer::Pass::SPATIAL_DENOISER:	return "spatial denoiser";
+		case GtaoBuffer::Pass::TEMPORAL_DENOISER:	return "temporal denoiser";
+		default:									return "?";
+		}
+	}
+}
+
+GtaoBuffer::GtaoBuffer(U32 width, U32 height, Layout layout)
+	: m_width(width), m_height(height), m_layout(layout), m_timer(U32(Pass::COUNT)), m_layoutStats(layout)
+{
+	for (GLU& rBuf : m_aBufConfidence) {
+		glCreateTextures(GL_TEXTURE_2D, 1, &rBuf);
+		glTextureStorage2D(rBuf, 1, GL_R8, width, height);
+	}
+	SetLayout(layout);
+}
+
+GtaoBuffer::~GtaoBuffer() {
+	g_stateCache.DeleteTexture(m_bufRaw);
+	g_stateCache.DeleteTexture(m_bufSpatiallyDenoised);
+	for (GLU buf : m_aBufAccumulation)
+		g_stateCache.DeleteTexture(buf);
+	for (GLU buf : m_aBufConfidence)
+		g_stateCache.DeleteTexture(buf);
+}
+
+void GtaoBuffer::SetLayout(Layout layout) {
+	if (m_bufRaw != 0 && layout == m_layout)
+		return;
+	std::array<GLU*, 4> aPBuf = { &m_bufRaw, &m_bufSpatiallyDenoised, &m_aBufAccumulation[0], &m_aBufAccumulation[1] };
+	m_layout = layout;
+	for (GLU* pBuf : aPBuf) {
+		if (*pBuf != 0)
+			g_stateCache.DeleteTexture(*pBuf);
+		glCreateTextures(GL_TEXTURE_2D, 1, pBuf);
+		glTextureStorage2D(*pBuf, 1, GetFormat(layout), m_width, m_height);
+	}
+	// unoccluded history, shading uses normal of G-buffer at ao 1 whatever bent normal decodes to
+	// (degenerate in RGBA8, +z in octahedral RGB10A2)
+	const F32 aUnoccluded[4] = { 1, 0.5f, 0.5f, 0.5f };
+	for (GLU buf : m_aBufAccumulation)
+		glClearTexImage(buf, 0, GL_RGBA, GL_FLOAT, aUnoccluded);
+	for (GLU buf : m_aBufConfidence)
+		glClearTexImage(buf, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+}
+
+void GtaoBuffer::EndFrame() {
+	m_aLayoutIssued[m_timer.GetIdxFrame()] = m_layout;
+	m_timer.EndFrame([this](U32 idxPass) { return GetBytes(Pass(idxPass), m_aLayoutIssued[m_timer.GetIdxFrame()]); });
+	m_layoutStats = m_aLayoutIssued[m_timer.GetIdxFrame()];
+}
+
+void GtaoBuffer::PrintStats() const {
+	std::cout << "GTAO " << GetName(m_layoutStats) << ", " << GetBytesPerPixel(m_layoutStats) << " B per pixel\n";
+	m_timer.PrintStats([](U32 idxPass) { return GetName(Pass(idxPass)); });
+}
+
+GLE GtaoBuffer::GetFormat(Layout layout) {
+	switch (layout) {
+	case Layout::BENT_RGBA8:	return GL_RGBA8;
+	case Layout::BENT_RGB10A2:	return GL_RGB10_A2;
+	default:					return GL_R8;
+	}
+}
+
+Size GtaoBuffer::GetBytesPerPixel(Layout layout) {
+	return layout == Layout::SCALAR ? 1 : 4;
+}
+
+Size GtaoBuffer::GetBytes(Pass pass, Layout layout) const {
+	const Size bytesTarget = Size(m_width) * m_height * GetBytesPerPixel(layout);
+	const Size bytesConfidence = Size(m_width) * m_height;
+	switch (pass) {
+	case Pass::MAIN:				// depth and Hi-Z it marches aren't target, history read only where it stands in
+		return bytesConfidence + bytesTarget;
+	case Pass::SPATIAL_DENOISER:	// 4x4 neighbourhood read once thanks to cache, written once
+		return 2 * bytesTarget;
+	case Pass::TEMPORAL_DENOISER:	// current and history read, accumulation written, confidence as well
+		return 3 * bytesTarget + 2 * bytesConfidence;
+	default:
+		return 0;
+	}
+}
\ No newline at end of file
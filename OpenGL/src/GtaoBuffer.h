@@ -0,0 +1,67 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "PassTimer.h"
+
+#include <array>		// std::array
+
+// Half resolution targets of GTAO passes (raw, spatially denoised, two for temporal accumulation) in one of layouts:
+//   SCALAR          R8      ambient occlusion only, shading uses normal of G-buffer instead of bent one, 1 B per pixel
+//   BENT_RGBA8      RGBA8   ambient occlusion | world bent normal * 0.5 + 0.5, 4 B per pixel
+//   BENT_RGB10A2    RGB10A2 ambient occlusion | octahedral world bent normal * 0.5 + 0.5 | unused, 4 B per pixel,
+//                           10 bits of occlusion don't stall temporal accumulation as early as 8 bits do
+// Ambient occlusion is in r of every layout, encoding of the rest is in gtao.gl (LayoutGtao uniform).
+// Each accumulation target has R8 confidence beside it: how converged history is, so gtao.frag can sample less.
+// Also measures traffic of passes with PassTimer like GBuffer: GPU time and bytes of targets they read and write,
+// so layouts can be compared.
+class GtaoBuffer
+{
+public:
+	enum class Layout : U32 { SCALAR, BENT_RGBA8, BENT_RGB10A2, COUNT };
+	enum class Pass : U32 { MAIN, SPATIAL_DENOISER, TEMPORAL_DENOISER, COUNT };
+
+	GtaoBuffer(U32 width, U32 height, Layout layout);
+	~GtaoBuffer();
+	GtaoBuffer(const GtaoBuffer&) = delete;
+	GtaoBuffer& operator=(const GtaoBuffer&) = delete;
+
+	// recreates all targets, history of temporal accumulation starts over
+	void SetLayout(Layout layout);
+	Layout GetLayout() const { return m_layout; }
+	static GLE GetFormat(Layout layout);
+
+	GLU GetRaw() const { return m_bufRaw; }
+	GLU GetSpatiallyDenoised() const { return m_bufSpatiallyDenoised; }
+	// temporal denoiser writes current one and reads previous one, swap makes current one previous for shading
+	GLU GetAccumulationCurr() const { return m_aBufAccumulation[m_idxAccumulationCurr]; }
+	GLU GetAccumulationPrev() const { return m_aBufAccumulation[1 - m_idxAccumulationCurr]; }
+	GLU GetConfidenceCurr() const { return m_aBufConfidence[m_idxAccumulationCurr]; }
+	GLU GetConfidencePrev() const { return m_aBufConfidence[1 - m_idxAccumulationCurr]; }
+	void SwapAccumulation() { m_idxAccumulationCurr = 1 - m_idxAccumulationCurr; }
+
+	// around work of pass, passes can't overlap
+	void BeginPass(Pass pass) { m_timer.BeginPass(U32(pass)); }
+	void EndPass(Pass pass) { m_timer.EndPass(U32(pass)); }
+	// reads back queries of oldest frame
+	void EndFrame();
+	// time and traffic of passes from a few frames ago
+	void PrintStats() const;
+
+private:
+	static Size GetBytesPerPixel(Layout layout);
+	Size GetBytes(Pass pass, Layout layout) const;
+
+	U32 m_width;
+	U32 m_height;
+	Layout m_layout;
+	GLU m_bufRaw = 0;
+	GLU m_bufSpatiallyDenoised = 0;
+	std::array<GLU, 2> m_aBufAccumulation = {};
+	std::array<GLU, 2> m_aBufConfidence = {};
+	U32 m_idxAccumulationCurr = 0;
+
+	PassTimer m_timer;
+	std::array<Layout, PassTimer::kNumFramesQuery> m_aLayoutIssued = {};	// layout can change before readback
+	Layout m_layoutStats;
+};
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "HiZ.h"
+
+#include <cstddef>	// offsetof
+
+namespace {
+	// std430 layout of Reduction in hiZ.comp
+	struct Reduction {
+		U32 m_numGroupsDone;
+		U32 m_minDepthBits;
+		U32 m_maxDepthBits;
+		U32 m_padding;
+		Vec2 m_depthBounds;
+	};
+
+	// each work group reduces 64x64 depth pixels
+	constexpr U32 kSizeGroupTile = 64;
+}
+
+HiZ::HiZ(U32 wDepth, U32 hDepth)
+	: m_passBuild("hiZ.comp"), m_wDepth(wDepth), m_hDepth(hDepth)
+{
+	// level 0 padded to multiple of texels covered by one texel of last level,
+	// so sizes of levels (rounded down by OGL) never cut off texels that cover screen
+	const U32 kTexelsLastLevel = 1 << (kNumLevels - 1);
+	const U32 kPixelsLastLevel = kTexelsLastLevel * 2;
+	const U32 wLevel0 = (wDepth + kPixelsLastLevel - 1) / kPixelsLastLevel * kTexelsLastLevel;
+	const U32 hLevel0 = (hDepth + kPixelsLastLevel - 1) / kPixelsLastLevel * kTexelsLastLevel;
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+	glTextureStorage2D(m_texture, kNumLevels, GL_RG32F, wLevel0, hLevel0);
+
+	Reduction reduction = {};
+	reduction.m_minDepthBits = 0x3f800000; // 1.f
+	glCreateBuffers(1, &m_bufReduction);
+	glNamedBufferStorage(m_bufReduction, sizeof(reduction), &reduction, 0);
+
+	// persistently mapped, so reading finished copies doesn't stall
+	for (U32 i = 0; i < kNumReadbacks; i++) {
+		const GLE flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &m_aBufReadback[i]);
+		glNamedBufferStorage(m_aBufReadback[i], sizeof(Vec2), nullptr, flags);
+		m_aMappedReadback[i] = (const Vec2*)glMapNamedBufferRange(m_aBufReadback[i], 0, sizeof(Vec2), flags);
+	}
+}
+
+HiZ::~HiZ() {
+	for (U32 i = 0; i < kNumReadbacks; i++) {
+		if (m_aFence[i] != nullptr)
+			glDeleteSync(m_aFence[i]);
+		glUnmapNamedBuffer(m_aBufReadback[i]);
+	}
+	glDeleteBuffers(kNumReadbacks, m_aBufReadback.data());
+	glDeleteBuffers(1, &m_bufReduction);
+	g_stateCache.DeleteTexture(m_texture);
+}
+
+void HiZ::Build(GLU depth, Bool readBounds) {
+	m_passBuild.Use();
+	g_stateCache.BindTextureUnit(0, depth);
+	g_stateCache.BindSampler(0, 0); // texelFetch, but sampler with compare mode would still apply
+	for (U32 i = 0; i < kNumLevels; i++)
+		glBindImageTexture(i, m_texture, i, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_bufReduction);
+	glDispatchCompute((m_wDepth + kSizeGroupTile - 1) / kSizeGroupTile, (m_hDepth + kSizeGroupTile - 1) / kSizeGroupTile, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	if (!readBounds)
+		return;
+
+	// oldest readback is kNumReadbacks frames old, so waiting for it practically never blocks
+	GLsync& rFence = m_aFence[m_idxReadback];
+	if (rFence != nullptr) {
+		glClientWaitSync(rFence, GL_SYNC_FLUSH_COMMANDS_BIT, ~0ull);
+		glDeleteSync(rFence);
+		m_depthBounds = *m_aMappedReadback[m_idxReadback];
+		m_hasDepthBounds = true;
+	}
+	glCopyNamedBufferSubData(m_bufReduction, m_aBufReadback[m_idxReadback], offsetof(Reduction, m_depthBounds), 0, sizeof(Vec2));
+	rFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_idxReadback = (m_idxReadback + 1) % kNumReadbacks;
+}
\ No newline at end of file
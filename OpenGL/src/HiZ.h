@@ -0,0 +1,52 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Shader.h"		// Shader
+
+#include <array>		// std::array
+
+// Min/max pyramid of reversed-Z depth (RG32F, x min = farthest, y max = closest), built in one dispatch.
+// Level 0 is half resolution and texel (x, y) of level n covers depth pixels [(x, y), (x, y) + 1] * 2^(n+1),
+// so readers fetch texels with texelFetch(HiZ, pixel >> (n + 1), n) instead of normalized coordinates
+// (levels are padded, texels past screen copy its edge).
+// Also reduces depth bounds of visible geometry, which are read back a few frames later without stalls.
+class HiZ
+{
+public:
+	static constexpr U32 kNumLevels = 8;
+
+	HiZ(U32 wDepth, U32 hDepth);
+	~HiZ();
+	HiZ(const HiZ&) = delete;
+	HiZ& operator=(const HiZ&) = delete;
+
+	// depth is bound to texture unit 0, readBounds queues readback of depth bounds
+	void Build(GLU depth, Bool readBounds);
+
+	GLU GetTexture() const { return m_texture; }
+	U32 GetWDepth() const { return m_wDepth; }
+	U32 GetHDepth() const { return m_hDepth; }
+
+	// x min (farthest) and y max (closest) depth without sky from a few frames ago,
+	// false until first readback arrives or when there was no geometry on screen
+	Bool GetDepthBounds(Vec2& rBounds) const {
+		rBounds = m_depthBounds;
+		return m_hasDepthBounds && m_depthBounds.y > 0;
+	}
+
+private:
+	static constexpr U32 kNumReadbacks = 3;
+
+	Shader m_passBuild;
+	U32 m_wDepth;
+	U32 m_hDepth;
+	GLU m_texture = 0;
+	GLU m_bufReduction = 0;
+	std::array<GLU, kNumReadbacks> m_aBufReadback = {};
+	std::array<const Vec2*, kNumReadbacks> m_aMappedReadback = {};
+	std::array<GLsync, kNumReadbacks> m_aFence = {};
+	U32 m_idxReadback = 0;
+	Vec2 m_depthBounds = Vec2(0);
+	Bool m_hasDepthBounds = false;
+};
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "JobSystem.h"
+#include "Profiler.h"	// g_profiler
+
+#include <algorithm>	// std::max, std::min
+
+JobSystem g_jobSystem;
+
+namespace {
+	// 0 for thread which created job system (and any other which isn't its worker)
+	thread_local U32 t_idxThread = 0;
+}
+
+JobSystem::JobSystem()
+	: m_aQueue(std::max(std::thread::hardware_concurrency(), 1u))
+{
+	for (U32 i = 1; i < m_aQueue.size(); i++)
+		m_aWorker.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutexSleep);
+		m_quit = true;
+	}
+	m_cvWork.notify_all();
+	for (std::thread& rWorker : m_aWorker)
+		rWorker.join();
+}
+
+void JobSystem::Run(const char* label, std::function<void()> job, Counter& rCounter) {
+	rCounter.fetch_add(1);
+	Push(m_aQueue[t_idxThread], { std::move(job), &rCounter, label });
+}
+
+void JobSystem::RunBackground(const char* label, std::function<void()> job, Counter& rCounter) {
+	rCounter.fetch_add(1);
+	Push(m_queueBackground, { std::move(job), &rCounter, label });
+}
+
+void JobSystem::Wait(const Counter& rCounter) {
+	while (rCounter.load() != 0)
+		if (!TryRunJob(t_idxThread) && !(m_aWorker.empty() && TryRunBackgroundJob()))
+			std::this_thread::yield(); // remaining jobs are running on other threads
+}
+
+void JobSystem::RunBackgroundWithoutWorkers() {
+	if (m_aWorker.empty())
+		TryRunBackgroundJob();
+}
+
+void JobSystem::ParallelFor(const char* label, U32 count, U32 sizeBatch, const std::function<void(U32 first, U32 end)>& rBody) {
+	sizeBatch = std::max(sizeBatch, 1u);
+	Counter counter{ 0 };
+	for (U32 first = 0; first < count; first += sizeBatch) {
+		const U32 end = std::min(first + sizeBatch, count);
+		Run(label, [&rBody, first, end] { rBody(first, end); }, counter);
+	}
+	Wait(counter);
+}
+
+void JobSystem::Push(Queue& rQueue, Job job) {
+	{
+		std::lock_guard<std::mutex> lock(rQueue.m_mutex);
+		rQueue.m_aJob.push_back(std::move(job));
+	}
+	// counted before taking sleep mutex, so worker either sees it or is already waiting for notification
+	(&rQueue == &m_queueBackground ? m_numQueuedBackground : m_numQueued).fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(m_mutexSleep);
+	}
+	m_cvWork.notify_one();
+}
+
+Bool JobSystem::TryRunJob(U32 idxThread) {
+	if (m_numQueued.load() == 0)
+		return false;
+
+	Job job;
+	Bool found = false;
+	for (U32 i = 0; i < m_aQueue.size() && !found; i++) {
+		const U32 idxQueue = (idxThread + i) % U32(m_aQueue.size());
+		Queue& rQueue = m_aQueue[idxQueue];
+		std::lock_guard<std::mutex> lock(rQueue.m_mutex);
+		if (rQueue.m_aJob.empty())
+			continue;
+		if (idxQueue == idxThread) {
+			job = std::move(rQueue.m_aJob.back());
+			rQueue.m_aJob.pop_back();
+		} else {
+			job = std::move(rQueue.m_aJob.front());
+			rQueue.m_aJob.pop_front();
+		}
+		found = true;
+	}
+	if (!found)
+		return false;
+	m_numQueued.fetch_sub(1);
+	Execute(job);
+	return true;
+}
+
+Bool JobSystem::TryRunBackgroundJob() {
+	if (m_numQueuedBackground.load() == 0)
+		return false;
+
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(m_queueBackground.m_mutex);
+		if (m_queueBackground.m_aJob.empty())
+			return false;
+		job = std::move(m_queueBackground.m_aJob.front());
+		m_queueBackground.m_aJob.pop_front();
+	}
+	m_numQueuedBackground.fetch_sub(1);
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(Job& rJob) {
+	const Profiler::Clock::time_point begin = Profiler::Clock::now();
+	rJob.m_function();
+	g_profiler.Record(rJob.m_label, begin, Profiler::Clock::now());
+	rJob.m_pCounter->fetch_sub(1);
+}
+
+void JobSystem::WorkerLoop(U32 idxThread) {
+	t_idxThread = idxThread;
+	while (true) {
+		if (TryRunJob(idxThread) || TryRunBackgroundJob())
+			continue;
+		std::unique_lock<std::mutex> lock(m_mutexSleep);
+		m_cvWork.wait(lock, [this] { return m_quit || m_numQueued.load() != 0 || m_numQueuedBackground.load() != 0; });
+		if (m_quit)
+			return;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+#include "types.h"
+
+#include <atomic>				// std::atomic
+#include <condition_variable>	// std::condition_variable
+#include <deque>				// std::deque
+#include <functional>			// std::function
+#include <mutex>				// std::mutex
+#include <thread>				// std::thread
+#include <vector>				// std::vector
+
+// Work stealing job system: worker per remaining core, every thread (main one included) has its own deque.
+// Owner pushes and pops jobs at the back (newest first, data is still in cache), idle threads steal
+// from the front of others (oldest first, usually the biggest chunks of work).
+// Dependencies are counters: job increments its counter when queued and decrements it when finished,
+// and waiting on counter runs other jobs meanwhile, so jobs can wait for jobs they spawned.
+// Background jobs (streaming) sit in shared queue, which only idle workers take from,
+// so waiting for per-frame work never ends up running them.
+// Every job is timed under its label in g_profiler.
+class JobSystem
+{
+public:
+	using Counter = std::atomic<U32>;
+
+	JobSystem();
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// workers and thread which created job system
+	U32 GetNumThreads() const { return U32(m_aWorker.size()) + 1; }
+
+	// label has to be string literal
+	void Run(const char* label, std::function<void()> job, Counter& rCounter);
+	// for long jobs frames shouldn't wait for
+	void RunBackground(const char* label, std::function<void()> job, Counter& rCounter);
+	// runs jobs until counter drops to 0
+	void Wait(const Counter& rCounter);
+	// with no workers runs one background job on calling thread, call once per frame so they progress anyway
+	void RunBackgroundWithoutWorkers();
+	// calls rBody(first, end) for ranges of at most sizeBatch items covering [0, count) and waits for them
+	void ParallelFor(const char* label, U32 count, U32 sizeBatch, const std::function<void(U32 first, U32 end)>& rBody);
+
+private:
+	struct Job {
+		std::function<void()> m_function;
+		Counter* m_pCounter;
+		const char* m_label;
+	};
+
+	struct Queue {
+		std::mutex m_mutex;
+		std::deque<Job> m_aJob;
+	};
+
+	void Push(Queue& rQueue, Job job);
+	// pops own job or steals one and runs it, false when all queues are empty
+	Bool TryRunJob(U32 idxThread);
+	Bool TryRunBackgroundJob();
+	void Execute(Job& rJob);
+	void WorkerLoop(U32 idxThread);
+
+	std::vector<Queue> m_aQueue;
+	Queue m_queueBackground;
+	std::vector<std::thread> m_aWorker;
+	std::atomic<U32> m_numQueued{ 0 };
+	std::atomic<U32> m_numQueuedBackground{ 0 };
+	std::mutex m_mutexSleep;
+	std::condition_variable m_cvWork;
+	Bool m_quit = false;
+};
+
+extern JobSystem g_jobSystem;
\ No newline at end of file
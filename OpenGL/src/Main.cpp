@@ -10,6 +10,20 @@
 #include "Shader.h"						// Shader
 #include "Camera.h"						// Camera
 #include "Model.h"						// Model
+#include "StateCache.h"					// g_stateCache
+#include "HiZ.h"						// HiZ
+#include "GBuffer.h"					// GBuffer
+#include "GtaoBuffer.h"				// GtaoBuffer
+#include "VisibilityBuffer.h"			// VisibilityBuffer
+#include "ClusteredLights.h"			// ClusteredLights
+#include "TiledShading.h"				// TiledShading
+#include "TiledShadows.h"				// TiledShadows
+#include "ShadowMapMinMax.h"				// ShadowMapMinMax
+#include "ShadowMapEvsm.h"				// ShadowMapEvsm
+#include "ShadowAtlas.h"				// ShadowAtlas
+#include "JobSystem.h"					// g_jobSystem
+#include "Profiler.h"					// g_profiler, ProfileScope
+#include "UploadManager.h"				// UploadManager
 #include "error.h"						// PrintErrorAndAbort
 
 #include <array>						// std::array
@@ -21,13 +35,16 @@ const U32 g_kWScreen = 1920;
 const U32 g_kHScreen = 1080;
 const U32 g_kNumCascades = 4;
 const Bool g_kVSync = true;
+const Vec3 g_kColorSky(0.5f, 0.8f, 1.6f);	// I don't draw skybox (I'm lazy)
 
 std::array<Mat4, g_kNumCascades>
-CalculateCascadeViewProj(const std::array<F32, g_kNumCascades + 1> & limitsCascade, const Camera & g_camera, const F32 sShadowMap, const Vec3 dirLight);
+CalculateCascadeViewProj(const std::array<F32, g_kNumCascades + 1> & limitsCascade, const Camera & g_camera, const std::array<U32, g_kNumCascades> & aSizeCascade, const Vec3 dirLight);
 std::array<F32, g_kNumCascades + 1>
 CalculateVsLimitsCascade(F32 nearPlane, F32 farPlane);
 Vec4
 CalculateToneMappingParamsLottes(F32 whitePoint);
+std::vector<ClusteredLights::Light>
+CreateLocalLights(Vec3 wsMin, Vec3 wsMax, U32 numLights);
 
 void CallbackMouse(GLFWwindow* window, F64 xpos, F64 ypos);
 void CallbackScroll(GLFWwindow* window, F64 xoffset, F64 yoffset);
@@ -35,6 +52,7 @@ void CallbackKeyboard(GLFWwindow* window, I32 key, I32 scancode, I32 action, I32
 void CallbackMessage(GLE source, GLE type, GLU id, GLE severity, GLS length, const GLC* message, const void* userParam);
 void ProcessInput(GLFWwindow* window, F32 deltaTime);
 void RenderQuad();
+void Run(GLFWwindow* window);
 
 Camera	g_camera(Vec3(0.0f, 0.0f, 3.0f));
 
@@ -49,15 +67,40 @@ I32		g_cascadeIdx = 0;
 Vec3	g_wsPosSun(217, 265, -80);
 F32		g_sizeFilterShadow = 50;
 F32		g_widthLight = 300;
+U32		g_downscaleShadow = 1;	// deferred shadows in 1/1, 1/2 or 1/4 of resolution
+Bool	g_enableEvsm = false;	// filtered EVSM instead of disc PCSS
+Bool	g_enableShadowCache = true;	// static geometry rendered to cascades only when they change
+U32		g_interleaveShadows = 1;	// deferred shadows of 1/1, 1/2 or 1/4 of cells per frame, the rest reprojected
 
 F32		g_wsSizeKernelAO = 3.5;
 F32		g_rateOfChangeAO = 0.2;
 Bool	g_enableAO = true;
 Bool	g_showAO = false;
+GtaoBuffer::Layout g_layoutGtao = GtaoBuffer::Layout::BENT_RGBA8;
+Bool	g_enableAdaptiveAO = true;	// fewer GTAO steps where its history converged
+U32		g_interleaveAO = 1;	// GTAO of 1/1, 1/2 or 1/4 of cells per frame, the rest reprojected
+Bool	g_printGtao = false;
+
+U32		g_numLocalLights = 256;
 
 F32		g_rateOfChangeTAA = 0.05;
 Bool	g_tAA = true;
 
+Bool	g_printStateStats = false;
+Bool	g_printCpuTimings = false;
+Bool	g_printTextureStreaming = false;
+Bool	g_printGBuffer = false;
+GBuffer::Layout g_layoutGBuffer = GBuffer::Layout::OCTAHEDRAL_8;
+Bool	g_enableVisibilityBuffer = false;
+Bool	g_enableDepthPrepass = true;
+Bool	g_enableDrawSorting = true;
+Bool	g_enableTiledShading = true;
+Bool	g_enableTiledShadows = true;
+Bool	g_enableLod = true;
+Bool	g_enableMeshletCulling = true;
+Bool	g_enableSdsm = true;
+Bool	g_enableOcclusionCpu = true;
+
 int main() {
 	// glfw: initialize and configure
 	// ------------------------------
@@ -88,19 +131,26 @@ int main() {
 	if (gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) == 0)
 		PrintErrorAndAbort("Failed to initialize GLAD");
 
+	Run(window);
+	glfwTerminate();
+	return 0;
+}
+
+// everything owning GL objects is local here, so destructors run before glfwTerminate() destroys context
+void Run(GLFWwindow* window) {
 	// configure global opengl state
 	// -----------------------------
 	glEnable(GL_DEBUG_OUTPUT);
 	glDebugMessageCallback(CallbackMessage, nullptr);
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_GEQUAL);					// 1 near, 0 far
+	g_stateCache.Enable(GL_DEPTH_TEST);
+	g_stateCache.DepthFunc(GL_GEQUAL);		// 1 near, 0 far
 	glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
 	//glDepthRange(0, 1);					// it's default
 	glClearDepth(0.f);						
 	
-	glClearColor(0.5f, 0.8f, 1.6f, 1.0f);	// color of sky, I don't draw skybox (I'm lazy)
-	glEnable(GL_CULL_FACE);
+	glClearColor(g_kColorSky.x, g_kColorSky.y, g_kColorSky.z, 1.0f);
+	g_stateCache.Enable(GL_CULL_FACE);
 	glPolygonOffset(-2.5, -8);				// slope scale and constant depth bias for shadow map rendering
 	
 	// create textures for render targets
@@ -119,25 +169,25 @@ int main() {
 	GLU bufDiffuseLightSingleValue;
 	glCreateTextures(GL_TEXTURE_2D, 1, &bufDiffuseLightSingleValue);
 	glTextureStorage2D(bufDiffuseLightSingleValue, 1, GL_R16F, 1, 1);
-	GLU bufDiffuseSpec;
-	glCreateTextures(GL_TEXTURE_2D, 1, &bufDiffuseSpec);
-	glTextureStorage2D(bufDiffuseSpec, 1, GL_RGBA8, g_kWScreen, g_kHScreen);
-	GLU bufNormal;
-	glCreateTextures(GL_TEXTURE_2D, 1, &bufNormal);
-	glTextureStorage2D(bufNormal, 1, GL_RGB10_A2, g_kWScreen, g_kHScreen); // not using A2
 	GLU bufDepth;
 	glCreateTextures(GL_TEXTURE_2D, 1, &bufDepth);
 	glTextureStorage2D(bufDepth,1, GL_DEPTH_COMPONENT32F, g_kWScreen, g_kHScreen);
-	GLU bufVelocity;
-	glCreateTextures(GL_TEXTURE_2D, 1, &bufVelocity);
-	glTextureStorage2D(bufVelocity, 1, GL_RG16F, g_kWScreen, g_kHScreen);
 	GLU bufShadowDeferred;
 	glCreateTextures(GL_TEXTURE_2D, 1, &bufShadowDeferred);
 	glTextureStorage2D(bufShadowDeferred, 1, GL_R8, g_kWScreen, g_kHScreen);
+	// previous frame, where interleaved deferred shadows reproject skipped cells from
+	GLU bufShadowDeferredPrev;
+	glCreateTextures(GL_TEXTURE_2D, 1, &bufShadowDeferredPrev);
+	glTextureStorage2D(bufShadowDeferredPrev, 1, GL_R8, g_kWScreen, g_kHScreen);
+	glClearTexImage(bufShadowDeferredPrev, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+	// level 0 half, level 1 quarter resolution, upsampled into bufShadowDeferred
+	GLU bufShadowLowRes;
+	glCreateTextures(GL_TEXTURE_2D, 1, &bufShadowLowRes);
+	glTextureStorage2D(bufShadowLowRes, 2, GL_R8, g_kWScreen / 2, g_kHScreen / 2);
 	
 	// create and configure framebuffers
 	// ---------------------------------
-	auto CreateConfigureFrameBuffer = [](std::vector<GLU> aCollorAtt, GLU depthAtt = 0, Bool isDepthLayerd = false) {
+	auto CreateConfigureFrameBuffer = [](std::vector<GLU> aCollorAtt, GLU depthAtt = 0) {
 		std::vector<GLU> aAttachment;
 		for (Size i = 0; i < aCollorAtt.size(); i++)
 			aAttachment.push_back(GL_COLOR_ATTACHMENT0 + i);
@@ -146,12 +196,8 @@ int main() {
 		glNamedFramebufferDrawBuffers(fbo, aAttachment.size(), aAttachment.data());
 		for (Size i = 0; i < aAttachment.size(); i++)
 			glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0+i, aCollorAtt[i], 0);
-		if (depthAtt != 0) {
-			if (isDepthLayerd)
-				glNamedFramebufferTextureLayer(fbo, GL_DEPTH_ATTACHMENT, depthAtt, 0, 0);
-			else
-				glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depthAtt, 0);
-		}
+		if (depthAtt != 0)
+			glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depthAtt, 0);
 
 		if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 			PrintErrorAndAbort("Framebuffer not complete!");
@@ -159,18 +205,25 @@ int main() {
 		return fbo;
 	};
 
-	const GLU fboGeometry = CreateConfigureFrameBuffer({ bufDiffuseSpec, bufNormal, bufVelocity }, bufDepth);
+	GBuffer gBuffer(g_kWScreen, g_kHScreen, g_layoutGBuffer);
+	const GLU fboDepthPrepass = CreateConfigureFrameBuffer({}, bufDepth);
 	const GLU fboShadowDeferred = CreateConfigureFrameBuffer({ bufShadowDeferred });
+	const GLU fboShadowLowRes = CreateConfigureFrameBuffer({ bufShadowLowRes });
 	const GLU fboDeferred = CreateConfigureFrameBuffer({ bufHdr, bufDiffuseLight });
 	const GLU fboBack = CreateConfigureFrameBuffer({ bufLdrSrgb });
 
 	// create framebuffer for CSM
 	// --------------------------
+	// cascades render to rects of atlas, sized by their screen coverage
+	ShadowAtlas shadowAtlas(g_kNumCascades);
 	GLU bufDepthShadow;
-	GLS sShadowMap = 2048;
-	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &bufDepthShadow);
-	glTextureStorage3D(bufDepthShadow, 1, GL_DEPTH_COMPONENT16, sShadowMap, sShadowMap, g_kNumCascades);
-	const GLU fboShadowMap = CreateConfigureFrameBuffer({}, bufDepthShadow, true);
+	glCreateTextures(GL_TEXTURE_2D, 1, &bufDepthShadow);
+	glTextureStorage2D(bufDepthShadow, 1, GL_DEPTH_COMPONENT16, ShadowAtlas::kSize, ShadowAtlas::kSize);
+	// static layer, same rects: Sponza is cached there, bufDepthShadow is its copy with moving meshes over it
+	GLU bufDepthShadowStatic;
+	glCreateTextures(GL_TEXTURE_2D, 1, &bufDepthShadowStatic);
+	glTextureStorage2D(bufDepthShadowStatic, 1, GL_DEPTH_COMPONENT16, ShadowAtlas::kSize, ShadowAtlas::kSize);
+	const GLU fboShadowMapStatic = CreateConfigureFrameBuffer({}, bufDepthShadowStatic);
 	
 	// create samplers for shadow mapping
 	GLU samplerShadowDepth;
@@ -183,36 +236,21 @@ int main() {
 	glCreateSamplers(1, &samplerShadowPCF);
 	glSamplerParameteri(samplerShadowPCF, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
 	glSamplerParameteri(samplerShadowPCF, GL_TEXTURE_COMPARE_FUNC, GL_GEQUAL);
+	// hardware PCF, compute passes of TiledShadows have no derivatives to pick min filter from
+	glSamplerParameteri(samplerShadowPCF, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(samplerShadowPCF, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glSamplerParameteri(samplerShadowPCF, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glSamplerParameteri(samplerShadowPCF, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 	// CSM invariants
 	// --------------
-	const std::array<F32, g_kNumCascades + 1> aVsLimitsCascade = CalculateVsLimitsCascade(1, 1000);
-	const std::array<F32, g_kNumCascades> aVsFarCascade	= [](const std::array<F32, g_kNumCascades + 1>& rAVsLimCascade) {
-		std::array<F32, g_kNumCascades> aVsFarCascade;
-		for (Size i = 0; i < g_kNumCascades; i++)
-			aVsFarCascade[i] = rAVsLimCascade[i + 1];
-		return aVsFarCascade;
-	}(aVsLimitsCascade);
+	const F32 kVsNearCascades = 1;
+	const F32 kVsFarCascades = 1000;
 	
 	// SSAO
-	GLU bufSsao;
-	glCreateTextures(GL_TEXTURE_2D, 1, &bufSsao);
-	glTextureStorage2D(bufSsao, 1, GL_R8, g_kWScreen/2, g_kHScreen/2);
-	const GLU fboSsao = CreateConfigureFrameBuffer({ bufSsao });
-
-	GLU bufSsaoSpatiallyDenoised;
-	glCreateTextures(GL_TEXTURE_2D, 1, &bufSsaoSpatiallyDenoised);
-	glTextureStorage2D(bufSsaoSpatiallyDenoised, 1, GL_R8, g_kWScreen / 2, g_kHScreen / 2);
-
-	GLU bufSsaoAccCurr;
-	glCreateTextures(GL_TEXTURE_2D, 1, &bufSsaoAccCurr);
-	glTextureStorage2D(bufSsaoAccCurr, 1, GL_R8, g_kWScreen / 2, g_kHScreen / 2);
-
-	GLU bufSsaoAccPrev;
-	glCreateTextures(GL_TEXTURE_2D, 1, &bufSsaoAccPrev);
-	glTextureStorage2D(bufSsaoAccPrev, 1, GL_R8, g_kWScreen / 2, g_kHScreen / 2);
+	GtaoBuffer gtaoBuffer(g_kWScreen / 2, g_kHScreen / 2, g_layoutGtao);
+	const GLU fboSsao = CreateConfigureFrameBuffer({ gtaoBuffer.GetRaw() });
+	const GLU fboSsaoTemporal = CreateConfigureFrameBuffer({ gtaoBuffer.GetAccumulationCurr(), gtaoBuffer.GetConfidenceCurr() });
 
 	GLU bufDepthHalfResCurr;
 	glCreateTextures(GL_TEXTURE_2D, 1, &bufDepthHalfResCurr);
@@ -250,7 +288,12 @@ int main() {
 	const Shader passDirectShadowAlphaMasked("shadow.vert", "shadow.frag", "", macroDefineAlphaMasked);
 	const Shader passGeometry("geometry.vert", "geometry.frag");
 	const Shader passGeometryAlphaMasked("geometry.vert", "geometry.frag", "", macroDefineAlphaMasked);
+	const Shader passDepthPrepass("shadow.vert", "shadow.frag");
+	const Shader passDepthPrepassAlphaMasked("shadow.vert", "shadow.frag", "", macroDefineAlphaMasked);
+	const Shader passVisibility("shadow.vert", "visibility.frag");
+	const Shader passVisibilityAlphaMasked("shadow.vert", "visibility.frag", "", macroDefineAlphaMasked);
 	const Shader passShadowDeferred("uv.vert", "shadowDeferred.frag");
+	const Shader passShadowUpsample("uv.vert", "shadowUpsample.frag");
 	const Shader passShading("uv.vert", "shading.frag");
 	const Shader passExposureTone("uv.vert", "exposureToneMap.frag");
 	const Shader passEyeAdaptation("eyeAdaptation.comp");
@@ -263,6 +306,12 @@ int main() {
 
 	const Shader passTaa("uv.vert", "taa.frag");
 
+	// min/max depth pyramid, used by occlusion culling, GTAO and SDSM
+	HiZ hiZ(g_kWScreen, g_kHScreen);
+	// blocker depth tiles for PCSS
+	ShadowMapMinMax shadowMapMinMax(ShadowAtlas::kSize);
+	ShadowMapEvsm shadowMapEvsm(ShadowAtlas::kSize, g_kNumCascades);
+
 	GLU samplerAnisoRepeat;
 	glCreateSamplers(1, &samplerAnisoRepeat);
 	glSamplerParameterf(samplerAnisoRepeat, GL_TEXTURE_MAX_ANISOTROPY, 16);
@@ -297,8 +346,31 @@ int main() {
 	
 	const GLU bufBlueNoise = TextureFromFile("models/", "blue_noise_64.tga", false);
 
-	const Model sceneSponza("sponza/sponza.dae");
+	// staging memory for uploads, big enough for largest texture with mips, budget of copies per frame
+	UploadManager uploadManager(64 << 20, 8 << 20);
+	// VRAM for streamed levels of textures, all levels of Sponza take ~270 MB
+	const Size kBudgetTextures = 192 << 20;
+	Model sceneSponza("sponza/sponza.dae", uploadManager, kBudgetTextures);
+	TextureStreamer& rTextureStreamer = sceneSponza.GetTextureStreamer();
+	VisibilityBuffer visibilityBuffer(g_kWScreen, g_kHScreen, sceneSponza.GetNumMaterials());
+	ClusteredLights clusteredLights(g_kWScreen, g_kHScreen);
+	TiledShading tiledShading(g_kWScreen, g_kHScreen);
+	TiledShadows tiledShadows(g_kWScreen, g_kHScreen);
+	// scattered over bounds of model, first g_numLocalLights of them are lit
+	const std::vector<ClusteredLights::Light> aLocalLight = CreateLocalLights(Vec3(sceneSponza.GetMatDequantize() * Vec4(0, 0, 0, 1)),
+		Vec3(sceneSponza.GetMatDequantize() * Vec4(1, 1, 1, 1)), ClusteredLights::kMaxLights);
+	DrawOrder drawOrderCamera;
+	std::array<DrawOrder, g_kNumCascades> aDrawOrderCascade;
+	g_profiler.EndFrame();
+	g_profiler.PrintStats(); // loading
 	Mat4 modelViewProjPrevSponza = glm::identity<Mat4>();
+	// matrices and rects static layer of cascades was rendered with, empty rect invalidates
+	std::array<Mat4, g_kNumCascades> aLightProjStatic;
+	std::array<ShadowAtlas::Rect, g_kNumCascades> aRectStatic = {};
+	// what draws of static layer depend on besides cascade, any change of it invalidates all cascades
+	U64 generationMasksStatic = 0;
+	F32 maxErrorLodPixelsStatic = -1;
+	Bool enableMeshletCullingStatic = false;
 	F64 frameTimePrev = 0;
 	U64 frameCount = -1;
 
@@ -314,62 +386,16 @@ int main() {
 
 		if (!g_kVSync)
 			std::cout << 1. / deltaTime << "\n";
-		
-		// CSM logic
-		// ---------
-		const Vec3 wsDirLight = glm::normalize(-g_wsPosSun); // sun looks at Vec3(0, 0, 0)
-		const std::array<Mat4, g_kNumCascades> aLightProj = CalculateCascadeViewProj(aVsLimitsCascade, g_camera, sShadowMap, wsDirLight);
-		// moves from <-1,1> NDC to <0,1> UV space
-		// by scaling by 0.5 in x and y to <-0.5, 0.5>
-		// and then translating by <0.5, 0.5> in x and y to <0, 1>
-		const Mat4 texScaleBias(
-			0.5f, 0.0f, 0.0f, 0.0f,
-			0.0f, 0.5f, 0.0f, 0.0f, // add "-" if you want have glClipControl(GL_UPPER_LEFT, (...))
-			0.0f, 0.0f, 1.0f, 0.0f,
-			0.5f, 0.5f, 0.0f, 1.0f
-		);
-		// equivalent to:
-		//const Mat4 texScaleBias = glm::scale(glm::translate(glm::identity<Mat4>(), Vec3(0.5, 0.5, 0)), Vec3(0.5, 0.5, 1));
-		
-		// create reference matrix from 1st cascade
-		const Mat4 referenceMatrix = texScaleBias * aLightProj[0];
-		// determine scale and offset for each cascade
-		std::array<Vec3, g_kNumCascades> aScaleCascade;
-		std::array<Vec3, g_kNumCascades> aOffsetCascade;
-		for (U32 i = 0; i < g_kNumCascades; i++) {
-			const Mat4 invShadowMatrix = glm::inverse(texScaleBias * aLightProj[i]);
-			Vec4 zeroCorner = referenceMatrix * invShadowMatrix * Vec4(0, 0, 0, 1);
-			Vec4 oneCorner  = referenceMatrix * invShadowMatrix * Vec4(1, 1, 1, 1);
-			zeroCorner /= zeroCorner.w;
-			oneCorner /= oneCorner.w;
-
-			aScaleCascade [i] = Vec3(1) / Vec3(oneCorner - zeroCorner);
-			aOffsetCascade[i] = -Vec3(zeroCorner);
-		}
 
+		rTextureStreamer.Update();
+		g_jobSystem.RunBackgroundWithoutWorkers();
+		uploadManager.Update();
+		
+		const float nearPlane = 0.1;
 		const Mat4 modelSponza = glm::identity<Mat4>();
-		// CSM rendering
-		// -------------
-		{
-			glEnable(GL_POLYGON_OFFSET_FILL);
-			glViewport(0, 0, sShadowMap, sShadowMap);
-			glBindFramebuffer(GL_FRAMEBUFFER, fboShadowMap);
-			for (Size i = 0; i < aLightProj.size(); i++) {
-				glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, bufDepthShadow, 0, i);
-				glClear(GL_DEPTH_BUFFER_BIT);
-				
-				passDirectShadow.SetMat4("ModelLightProj", aLightProj[i] * modelSponza);
-				passDirectShadow.Use();
-				sceneSponza.DrawGeometryOnly();
-				
-				passDirectShadowAlphaMasked.SetMat4("ModelLightProj", aLightProj[i] * modelSponza);
-				passDirectShadowAlphaMasked.Use();
-				glBindSampler(0, samplerPointClamp); // alpha mask
-				sceneSponza.DrawWithMaskOnly();
-			}
-			glDisable(GL_POLYGON_OFFSET_FILL);
-			glViewport(0, 0, g_kWScreen, g_kHScreen);
-		}
+		// vertex positions are quantized, dequantize them together with model transform
+		const Mat4 modelDequantizeSponza = modelSponza * sceneSponza.GetMatDequantize();
+		const F32 maxErrorLodPixels = g_enableLod ? 1.f : 0.f;
 		auto GetJitter = [](const U64 frameCount) {
 			auto HaltonSeq = [](I32 prime, I32 idx) {
 				F32 r = 0;
@@ -392,36 +418,266 @@ int main() {
 			const Vec2 jitter = GetJitter(frameCount);
 			return glm::translate(glm::identity<Mat4>(), Vec3(jitter, 0)) * proj;
 		};
-		const float nearPlane = 0.1;
 		const Mat4 projection = JitterProjection(CalculateInfReversedZProj(g_camera, (F32)g_kWScreen / (F32)g_kHScreen, nearPlane), frameCount);
 		const Mat4 view = g_camera.GetViewMatrix();
+		View viewCamera;
+		viewCamera.m_modelViewProj = projection * view * modelSponza;
+		viewCamera.m_msPosEye = Vec3(glm::inverse(modelSponza) * Vec4(g_camera.GetWsPosition(), 1));
+		viewCamera.m_pixelsPerUnit = projection[1][1] * g_kHScreen / 2;
+		viewCamera.m_maxErrorPixels = maxErrorLodPixels;
+
+		// CSM logic and CPU occlusion culling
+		// -----------------------------------
+		// independent of each other, so they run as jobs (culling splits further) while this thread helps
+		const Vec3 wsDirLight = glm::normalize(-g_wsPosSun); // sun looks at Vec3(0, 0, 0)
+		std::array<F32, g_kNumCascades + 1> aVsLimitsCascade;
+		std::array<F32, g_kNumCascades> aVsFarCascade;
+		std::array<Mat4, g_kNumCascades> aLightProj;
+		Mat4 referenceMatrix;
+		std::array<Vec3, g_kNumCascades> aScaleCascade;
+		std::array<Vec3, g_kNumCascades> aOffsetCascade;
+		std::array<Vec4, g_kNumCascades> aRectCascade;
+		{
+			ProfileScope profile("frame: CSM logic and CPU occlusion culling");
+			JobSystem::Counter counter{ 0 };
+			g_jobSystem.Run("CSM logic", [&] {
+				// SDSM: cascades cover only depth range of visible geometry, read back from Hi-Z of a few frames ago
+				F32 vsNearCascades = kVsNearCascades;
+				F32 vsFarCascades = kVsFarCascades;
+				Vec2 depthBounds;
+				if (g_enableSdsm && hiZ.GetDepthBounds(depthBounds)) {
+					// distance is near / depth with infinite reversed-Z projection,
+					// snapped to steps of 10 %, so splits (and texel snapping of cascades) don't change every frame
+					auto SnapDistance = [](F32 distance, F32 (*Round)(F32)) {
+						const F32 kStep = 1.1f;
+						return powf(kStep, Round(logf(distance) / logf(kStep)));
+					};
+					vsNearCascades = glm::clamp(SnapDistance(nearPlane / depthBounds.y, floorf), kVsNearCascades, kVsFarCascades / 2);
+					vsFarCascades = glm::clamp(SnapDistance(nearPlane / depthBounds.x, ceilf), vsNearCascades * 2, kVsFarCascades);
+				}
+				aVsLimitsCascade = CalculateVsLimitsCascade(vsNearCascades, vsFarCascades);
+				for (Size i = 0; i < g_kNumCascades; i++)
+					aVsFarCascade[i] = aVsLimitsCascade[i + 1];
+
+				// rects by coverage of a few frames ago, texel snapping of each cascade follows its size
+				shadowAtlas.Allocate(shadowAtlas.GetSizesCascades());
+				std::array<U32, g_kNumCascades> aSizeCascade;
+				for (U32 i = 0; i < g_kNumCascades; i++) {
+					aSizeCascade[i] = shadowAtlas.GetRect(i).m_size;
+					aRectCascade[i] = shadowAtlas.GetRectUv(i);
+				}
+
+				aLightProj = CalculateCascadeViewProj(aVsLimitsCascade, g_camera, aSizeCascade, wsDirLight);
+				// moves from <-1,1> NDC to <0,1> UV space
+				// by scaling by 0.5 in x and y to <-0.5, 0.5>
+				// and then translating by <0.5, 0.5> in x and y to <0, 1>
+				const Mat4 texScaleBias(
+					0.5f, 0.0f, 0.0f, 0.0f,
+					0.0f, 0.5f, 0.0f, 0.0f, // add "-" if you want have glClipControl(GL_UPPER_LEFT, (...))
+					0.0f, 0.0f, 1.0f, 0.0f,
+					0.5f, 0.5f, 0.0f, 1.0f
+				);
+				// equivalent to:
+				//const Mat4 texScaleBias = glm::scale(glm::translate(glm::identity<Mat4>(), Vec3(0.5, 0.5, 0)), Vec3(0.5, 0.5, 1));
+		
+				// create reference matrix from 1st cascade
+				referenceMatrix = texScaleBias * aLightProj[0];
+				// determine scale and offset for each cascade
+				for (U32 i = 0; i < g_kNumCascades; i++) {
+					const Mat4 invShadowMatrix = glm::inverse(texScaleBias * aLightProj[i]);
+					Vec4 zeroCorner = referenceMatrix * invShadowMatrix * Vec4(0, 0, 0, 1);
+					Vec4 oneCorner  = referenceMatrix * invShadowMatrix * Vec4(1, 1, 1, 1);
+					zeroCorner /= zeroCorner.w;
+					oneCorner /= oneCorner.w;
+
+					aScaleCascade [i] = Vec3(1) / Vec3(oneCorner - zeroCorner);
+					aOffsetCascade[i] = -Vec3(zeroCorner);
+				}
+			}, counter);
+			if (g_enableOcclusionCpu)
+				g_jobSystem.Run("occlusion CPU", [&] { sceneSponza.CullOcclusionCpu(viewCamera); }, counter);
+			g_jobSystem.Wait(counter);
+		}
+		if (g_enableDrawSorting)
+			sceneSponza.SortDraws(viewCamera, drawOrderCamera, DrawOrder::Policy::CAMERA);
+
+		// CSM rendering
+		// -------------
+		{
+			g_stateCache.Enable(GL_DEPTH_TEST);
+			g_stateCache.DepthFunc(GL_GEQUAL);
+			g_stateCache.DepthMask(true);
+			g_stateCache.Enable(GL_POLYGON_OFFSET_FILL);
+			g_stateCache.BindFramebuffer(fboShadowMapStatic);
+			// alpha masks stream in over placeholders (opaque 1x1) and change levels, LODs and meshlets follow toggles
+			const U64 generationMasks = sceneSponza.GetGenerationMasks();
+			const Bool isDrawsSame = generationMasks == generationMasksStatic && maxErrorLodPixels == maxErrorLodPixelsStatic
+				&& g_enableMeshletCulling == enableMeshletCullingStatic;
+			generationMasksStatic = generationMasks;
+			maxErrorLodPixelsStatic = maxErrorLodPixels;
+			enableMeshletCullingStatic = g_enableMeshletCulling;
+			for (Size i = 0; i < aLightProj.size(); i++) {
+				// static layer is rendered again only when sun, cascade matrix (splits, texel snapping), rect or draws changed
+				const ShadowAtlas::Rect& rRect = shadowAtlas.GetRect(i);
+				const ShadowAtlas::Rect& rRectStatic = aRectStatic[i];
+				const Bool isRectSame = rRect.m_x == rRectStatic.m_x && rRect.m_y == rRectStatic.m_y && rRect.m_size == rRectStatic.m_size;
+				if (g_enableShadowCache && isDrawsSame && isRectSame && aLightProj[i] == aLightProjStatic[i])
+					continue;
+				aLightProjStatic[i] = aLightProj[i];
+				aRectStatic[i] = rRect;
+
+				const F32 depthFar = 0; // reversed Z
+				glClearTexSubImage(bufDepthShadowStatic, 0, rRect.m_x, rRect.m_y, 0, rRect.m_size, rRect.m_size, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depthFar);
+				g_stateCache.Viewport(rRect.m_x, rRect.m_y, rRect.m_size, rRect.m_size);
+
+				const Mat4 modelLightProj = aLightProj[i] * modelSponza;
+				View viewCascade;
+				viewCascade.m_modelViewProj = modelLightProj;
+				viewCascade.m_perspective = false;
+				viewCascade.m_msDirView = glm::normalize(glm::inverse(Mat3(modelSponza)) * wsDirLight);
+				// orthographic, so texel footprint is the same everywhere: scale of x row times half of resolution
+				viewCascade.m_pixelsPerUnit = glm::length(Vec3(modelLightProj[0][0], modelLightProj[1][0], modelLightProj[2][0])) * rRect.m_size / 2;
+				viewCascade.m_maxErrorPixels = maxErrorLodPixels;
+				if (g_enableDrawSorting)
+					sceneSponza.SortDraws(viewCascade, aDrawOrderCascade[i], DrawOrder::Policy::SHADOW);
+				if (g_enableMeshletCulling) {
+					viewCascade.m_idxCull = 2 + i; // 0 and 1 are camera
+					sceneSponza.Cull(viewCascade);
+				}
+				
+				passDirectShadow.SetMat4("ModelLightProj", aLightProj[i] * modelDequantizeSponza);
+				passDirectShadow.Use();
+				sceneSponza.DrawPositionOnly(viewCascade);
+				
+				passDirectShadowAlphaMasked.SetMat4("ModelLightProj", aLightProj[i] * modelDequantizeSponza);
+				passDirectShadowAlphaMasked.SetFloat("RangeUv", sceneSponza.GetRangeUv());
+				passDirectShadowAlphaMasked.Use();
+				g_stateCache.BindSampler(0, samplerPointClamp); // alpha mask
+				sceneSponza.DrawWithMaskOnly(viewCascade);
+			}
+			// dynamic layer: static depth copied every frame, so moving meshes can be drawn over it
+			// (the scene has none yet, so its cost is just the copies)
+			for (Size i = 0; i < aLightProj.size(); i++) {
+				const ShadowAtlas::Rect& rRect = shadowAtlas.GetRect(i);
+				glCopyImageSubData(bufDepthShadowStatic, GL_TEXTURE_2D, 0, rRect.m_x, rRect.m_y, 0,
+					bufDepthShadow, GL_TEXTURE_2D, 0, rRect.m_x, rRect.m_y, 0, rRect.m_size, rRect.m_size, 1);
+			}
+			shadowMapMinMax.Build(bufDepthShadow);
+			if (g_enableEvsm)
+				shadowMapEvsm.Build(bufDepthShadow, aRectCascade.data());
+		}
+		// second draw of the camera, meshlets found visible in Hi-Z of first one
+		View viewCameraLate = viewCamera;
+		viewCameraLate.m_idxCull = 1;
+		viewCameraLate.m_culledOnly = true;
+		if (g_enableMeshletCulling) {
+			viewCamera.m_idxCull = 0;
+			sceneSponza.Cull(viewCamera, MeshletCuller::CullPhase::EARLY);
+		}
 		auto SetUniformsBasics = [&](const Shader& shader) {
-			shader.SetMat4("ModelViewProj", projection * view * modelSponza);
+			shader.SetMat4("ModelViewProj", projection * view * modelDequantizeSponza);
 			shader.SetMat4("ModelViewProjPrev", modelViewProjPrevSponza);
 			shader.SetMat3("NormalMatrix", glm::transpose(glm::inverse(Mat3(modelSponza))));
 			shader.SetBool("EnableNormalMapping", g_enableNormalMapping);
+			shader.SetBool("OctahedralNormals", gBuffer.IsOctahedral());
 			shader.SetVec2("JitterCurr", GetJitter(frameCount));
 			shader.SetVec2("JitterPrev", GetJitter(frameCount - 1));
+			shader.SetFloat("RangeUv", sceneSponza.GetRangeUv());
+			shader.SetUInt("FeedbackPixel", GLU(frameCount * 23 % 64)); // 23 is coprime with 64, so every pixel of tile gets its turn
 		};
 		// geometry pass
 		// -------------
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, fboGeometry);
-			glNamedFramebufferTexture(fboGeometry, GL_DEPTH_ATTACHMENT, bufDepth, 0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear color as well, because I don't render skybox
-			glClearTexImage(bufVelocity, 0, GL_RG, GL_UNSIGNED_BYTE, nullptr);
-			passGeometry.Use();
-			for (GLU i = 1; i <= 3; i++) // diffuse, specular, normal
-				glBindSampler(i, samplerAnisoRepeat);
-			glBindSampler(4, samplerPointClamp); // mask
+			g_stateCache.Enable(GL_DEPTH_TEST);
+			g_stateCache.DepthFunc(GL_GEQUAL);
+			g_stateCache.DepthMask(true);
+			g_stateCache.Disable(GL_POLYGON_OFFSET_FILL);
+			g_stateCache.Viewport(0, 0, g_kWScreen, g_kHScreen);
+			gBuffer.SetLayout(g_layoutGBuffer);
+			g_stateCache.BindFramebuffer(gBuffer.GetFramebuffer());
+			glNamedFramebufferTexture(gBuffer.GetFramebuffer(), GL_DEPTH_ATTACHMENT, bufDepth, 0);
+			gBuffer.Clear();
+			// visibility buffer pass writes only depth and ids already, so it gains nothing from prepass
+			const Bool depthPrepass = g_enableDepthPrepass && !g_enableVisibilityBuffer;
+			if (depthPrepass) {
+				gBuffer.BeginPass(GBuffer::Pass::DEPTH_PREPASS);
+				g_stateCache.BindFramebuffer(fboDepthPrepass);
+				glNamedFramebufferTexture(fboDepthPrepass, GL_DEPTH_ATTACHMENT, bufDepth, 0);
+				passDepthPrepass.SetMat4("ModelLightProj", projection * view * modelDequantizeSponza);
+				passDepthPrepassAlphaMasked.SetMat4("ModelLightProj", projection * view * modelDequantizeSponza);
+				passDepthPrepassAlphaMasked.SetFloat("RangeUv", sceneSponza.GetRangeUv());
+				auto DrawDepth = [&](const View& rView) {
+					passDepthPrepass.Use();
+					sceneSponza.DrawPositionOnly(rView);
+					passDepthPrepassAlphaMasked.Use();
+					g_stateCache.BindSampler(0, samplerPointClamp); // alpha mask
+					sceneSponza.DrawWithMaskOnly(rView);
+				};
+				DrawDepth(viewCamera);
+				if (g_enableMeshletCulling) {
+					hiZ.Build(bufDepth, false);
+					sceneSponza.Cull(viewCameraLate, MeshletCuller::CullPhase::LATE, &hiZ);
+					DrawDepth(viewCameraLate);
+				}
+				gBuffer.EndPass(GBuffer::Pass::DEPTH_PREPASS);
+				// the same draws shade only fragments which ended up closest, vertex shaders have invariant gl_Position
+				g_stateCache.BindFramebuffer(gBuffer.GetFramebuffer());
+				g_stateCache.DepthFunc(GL_EQUAL);
+				g_stateCache.DepthMask(false);
+			}
+			const GBuffer::Pass passGBuffer = g_enableVisibilityBuffer ? GBuffer::Pass::VISIBILITY : GBuffer::Pass::GEOMETRY;
+			gBuffer.BeginPass(passGBuffer);
 			SetUniformsBasics(passGeometry);
-			sceneSponza.Draw();
-
-			passGeometryAlphaMasked.Use();
 			SetUniformsBasics(passGeometryAlphaMasked);
-			sceneSponza.DrawWithMask();	
+			if (g_enableVisibilityBuffer) {
+				visibilityBuffer.Begin(bufDepth);
+				passVisibility.SetMat4("ModelLightProj", projection * view * modelDequantizeSponza);
+				passVisibilityAlphaMasked.SetMat4("ModelLightProj", projection * view * modelDequantizeSponza);
+				passVisibilityAlphaMasked.SetFloat("RangeUv", sceneSponza.GetRangeUv());
+				SetUniformsBasics(visibilityBuffer.GetPassMaterial());
+			}
+			auto DrawGeometry = [&](const View& rView) {
+				if (g_enableVisibilityBuffer) {
+					passVisibility.Use();
+					sceneSponza.DrawVisibility(rView, visibilityBuffer);
+					passVisibilityAlphaMasked.Use();
+					g_stateCache.BindSampler(0, samplerPointClamp); // alpha mask
+					sceneSponza.DrawVisibilityWithMask(rView, visibilityBuffer);
+					return;
+				}
+				passGeometry.Use();
+				for (GLU i = 1; i <= 3; i++) // diffuse, specular, normal
+					g_stateCache.BindSampler(i, samplerAnisoRepeat);
+				g_stateCache.BindSampler(4, samplerPointClamp); // mask
+				sceneSponza.Draw(rView);
+
+				// after prepass mask was already tested, so masked meshes keep early depth test without discard
+				(depthPrepass ? passGeometry : passGeometryAlphaMasked).Use();
+				sceneSponza.DrawWithMask(rView);
+			};
+			rTextureStreamer.BeginFeedback();
+			DrawGeometry(viewCamera);
+			// occlusion culling: test meshlets against what was drawn above and draw newly visible ones
+			// (prepass has culled them already)
+			if (g_enableMeshletCulling) {
+				if (!depthPrepass) {
+					hiZ.Build(bufDepth, false);
+					sceneSponza.Cull(viewCameraLate, MeshletCuller::CullPhase::LATE, &hiZ);
+				}
+				DrawGeometry(viewCameraLate);
+			}
+			if (g_enableVisibilityBuffer) {
+				for (GLU i = 1; i <= 3; i++) // diffuse, specular, normal
+					g_stateCache.BindSampler(i, samplerAnisoRepeat);
+				visibilityBuffer.Resolve(sceneSponza, gBuffer);
+			}
+			gBuffer.EndPass(passGBuffer);
+			rTextureStreamer.EndFeedback();
+			hiZ.Build(bufDepth, true);
+			// level 2 texels cover 8 x 8 pixels, plenty for sizes of rects
+			shadowAtlas.MeasureCoverage(hiZ.GetTexture(), 2, (hiZ.GetWDepth() + 7) / 8, (hiZ.GetHDepth() + 7) / 8, aVsLimitsCascade.data(), nearPlane);
 
-			modelViewProjPrevSponza = projection * view * modelSponza;
+			modelViewProjPrevSponza = projection * view * modelDequantizeSponza;
 		}
 		auto GetRadRodationTemporal = [](const U64 frameCount) {
 			const F32 aRotation[] = { 60, 300, 180, 240, 120, 0 };
@@ -432,127 +688,237 @@ int main() {
 		{
 			// downsample depth & velocity
 			{
-				glViewport(0, 0, g_kWScreen/2, g_kHScreen/2);
-				glBindFramebuffer(GL_FRAMEBUFFER, fboDepthDownsample);
+				g_stateCache.Disable(GL_DEPTH_TEST); // also disables depth writes
+				g_stateCache.Viewport(0, 0, g_kWScreen/2, g_kHScreen/2);
+				g_stateCache.BindFramebuffer(fboDepthDownsample);
 				glNamedFramebufferTexture(fboDepthDownsample, GL_COLOR_ATTACHMENT0, bufDepthHalfResCurr, 0);
 				passDepthVelocityDownsample.Use();
-				glBindTextureUnit(0, bufDepth);
-				glBindTextureUnit(1, bufVelocity);
-				glBindSampler(0, samplerPointClamp);
-				glBindSampler(1, samplerPointClamp);
+				g_stateCache.BindTextureUnit(0, bufDepth);
+				g_stateCache.BindTextureUnit(1, gBuffer.GetVelocity());
+				g_stateCache.BindSampler(0, samplerPointClamp);
+				g_stateCache.BindSampler(1, samplerPointClamp);
 				RenderQuad();
 			}
 			// main
 			{
-				glBindFramebuffer(GL_FRAMEBUFFER, fboSsao);
-				glNamedFramebufferTexture(fboSsao, GL_COLOR_ATTACHMENT0, bufSsao, 0);
-				glBindTextureUnit(0, bufDepthHalfResCurr);
-				glBindSampler(0, samplerPointClamp);
+				gtaoBuffer.SetLayout(g_layoutGtao);
+				gtaoBuffer.BeginPass(GtaoBuffer::Pass::MAIN);
+				g_stateCache.BindFramebuffer(fboSsao);
+				glNamedFramebufferTexture(fboSsao, GL_COLOR_ATTACHMENT0, gtaoBuffer.GetRaw(), 0);
+				g_stateCache.BindTextureUnit(0, bufDepthHalfResCurr);
+				g_stateCache.BindTextureUnit(1, hiZ.GetTexture());
+				g_stateCache.BindTextureUnit(2, bufVelocityHalfRes);
+				g_stateCache.BindTextureUnit(3, bufDepthHalfResPrev);
+				g_stateCache.BindTextureUnit(4, gtaoBuffer.GetAccumulationPrev());
+				g_stateCache.BindTextureUnit(5, gtaoBuffer.GetConfidencePrev());
+				for (GLU i = 0; i <= 5; i++)
+					g_stateCache.BindSampler(i, samplerPointClamp);
 
 				passSsao.Use();
 				passSsao.SetMat4("InvProj", glm::inverse(projection));
+				passSsao.SetMat4("InvView", glm::inverse(view));
+				passSsao.SetInt("LayoutGtao", I32(g_layoutGtao));
 				passSsao.SetFloat("WsRadius", g_wsSizeKernelAO);
 				passSsao.SetFloat("RadRotationTemporal", GetRadRodationTemporal(frameCount));
 				passSsao.SetVec4("Scaling", Vec4(g_kWScreen / 2, g_kHScreen / 2, 1. / (g_kWScreen / 2), 1. / (g_kHScreen / 2)));
+				passSsao.SetInt("NumLevelsHiZ", HiZ::kNumLevels);
+				passSsao.SetBool("Adaptive", g_enableAdaptiveAO);
+				passSsao.SetInt("Interleave", I32(g_interleaveAO));
+				passSsao.SetInt("IndexFrame", I32(frameCount % 4));
+				passSsao.SetFloat("Near", nearPlane);
 				RenderQuad();
+				gtaoBuffer.EndPass(GtaoBuffer::Pass::MAIN);
 			}
 			// spatial denoiser
 			{
-				glNamedFramebufferTexture(fboSsao, GL_COLOR_ATTACHMENT0, bufSsaoSpatiallyDenoised, 0);
-				glBindTextureUnit(0, bufSsao);
-				glBindTextureUnit(1, bufDepthHalfResCurr);
-				glBindSampler(0, samplerPointClamp);
-				glBindSampler(1, samplerPointClamp);
+				gtaoBuffer.BeginPass(GtaoBuffer::Pass::SPATIAL_DENOISER);
+				glNamedFramebufferTexture(fboSsao, GL_COLOR_ATTACHMENT0, gtaoBuffer.GetSpatiallyDenoised(), 0);
+				g_stateCache.BindTextureUnit(0, gtaoBuffer.GetRaw());
+				g_stateCache.BindTextureUnit(1, bufDepthHalfResCurr);
+				g_stateCache.BindSampler(0, samplerPointClamp);
+				g_stateCache.BindSampler(1, samplerPointClamp);
 				passSsaoSpatialDenoiser.Use();
 				passSsaoSpatialDenoiser.SetFloat("Near", nearPlane);
+				passSsaoSpatialDenoiser.SetInt("LayoutGtao", I32(g_layoutGtao));
 				RenderQuad();
+				gtaoBuffer.EndPass(GtaoBuffer::Pass::SPATIAL_DENOISER);
 			}
 			// temporal denoiser
 			{
-				glNamedFramebufferTexture(fboSsao, GL_COLOR_ATTACHMENT0, bufSsaoAccCurr, 0);
-				glBindTextureUnit(0, bufSsaoSpatiallyDenoised);
-				glBindTextureUnit(1, bufSsaoAccPrev);
-				glBindTextureUnit(2, bufVelocityHalfRes);
-				glBindTextureUnit(3, bufDepthHalfResCurr);
-				glBindTextureUnit(4, bufDepthHalfResPrev);
-				glBindSampler(0, samplerPointClamp);
-				glBindSampler(1, samplerLinearClamp);
-				glBindSampler(2, samplerPointClamp);
-				glBindSampler(3, samplerPointClamp);
-				glBindSampler(4, samplerPointClamp);
+				gtaoBuffer.BeginPass(GtaoBuffer::Pass::TEMPORAL_DENOISER);
+				g_stateCache.BindFramebuffer(fboSsaoTemporal);
+				glNamedFramebufferTexture(fboSsaoTemporal, GL_COLOR_ATTACHMENT0, gtaoBuffer.GetAccumulationCurr(), 0);
+				glNamedFramebufferTexture(fboSsaoTemporal, GL_COLOR_ATTACHMENT1, gtaoBuffer.GetConfidenceCurr(), 0);
+				g_stateCache.BindTextureUnit(0, gtaoBuffer.GetSpatiallyDenoised());
+				g_stateCache.BindTextureUnit(1, gtaoBuffer.GetAccumulationPrev());
+				g_stateCache.BindTextureUnit(2, bufVelocityHalfRes);
+				g_stateCache.BindTextureUnit(3, bufDepthHalfResCurr);
+				g_stateCache.BindTextureUnit(4, bufDepthHalfResPrev);
+				g_stateCache.BindTextureUnit(5, gtaoBuffer.GetConfidencePrev());
+				g_stateCache.BindSampler(0, samplerPointClamp);
+				g_stateCache.BindSampler(1, samplerLinearClamp);
+				g_stateCache.BindSampler(2, samplerPointClamp);
+				g_stateCache.BindSampler(3, samplerPointClamp);
+				g_stateCache.BindSampler(4, samplerPointClamp);
+				g_stateCache.BindSampler(5, samplerPointClamp);
 				passSsaoTemporalDenoiser.Use();
 				passSsaoTemporalDenoiser.SetFloat("RateOfChange", g_rateOfChangeAO);
 				passSsaoTemporalDenoiser.SetFloat("Near", nearPlane);
 				passSsaoTemporalDenoiser.SetVec2("Scaling", Vec2(g_kWScreen / 2, g_kHScreen / 2));
+				passSsaoTemporalDenoiser.SetInt("LayoutGtao", I32(g_layoutGtao));
 				RenderQuad();
+				gtaoBuffer.EndPass(GtaoBuffer::Pass::TEMPORAL_DENOISER);
 			}
-			glViewport(0, 0, g_kWScreen, g_kHScreen);
 			std::swap(bufDepthHalfResCurr, bufDepthHalfResPrev);
-			std::swap(bufSsaoAccCurr, bufSsaoAccPrev);
+			gtaoBuffer.SwapAccumulation();
 		}
 		// deffered shadows
 		// ----------------
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, fboShadowDeferred);
-			passShadowDeferred.Use();
-			
-			passShadowDeferred.SetVec3("WsDirLight", -wsDirLight);	// notice "-"
-			passShadowDeferred.SetFloatArr("AVsFarCascade", aVsFarCascade.data(), g_kNumCascades);
-			passShadowDeferred.SetMat4("ReferenceShadowMatrix", referenceMatrix);
-			passShadowDeferred.SetVec3Arr("AScaleCascade", aScaleCascade.data(), aScaleCascade.size());
-			passShadowDeferred.SetVec3Arr("AOffsetCascade", aOffsetCascade.data(), aOffsetCascade.size());
-			passShadowDeferred.SetFloat("WidthLight", g_widthLight);
-
-			passShadowDeferred.SetFloat("Bias", g_bias);
-			passShadowDeferred.SetFloat("ScaleNormalOffsetBias", g_scaleNormalOffsetBias);
-			passShadowDeferred.SetFloat("SizeFilter", g_sizeFilterShadow);
-			passShadowDeferred.SetMat4("InvViewProj", glm::inverse(projection* view));
-			passShadowDeferred.SetFloat("Near", nearPlane);
-			passShadowDeferred.SetFloat("RadRotationTemporal", GetRadRodationTemporal(frameCount));
-
-			glBindTextureUnit(0, bufNormal);
-			glBindTextureUnit(1, bufDepth);
-			glBindTextureUnit(2, bufDepthShadow);
-			glBindTextureUnit(3, bufDepthShadow);
-			glBindTextureUnit(4, bufBlueNoise);
-
-			glBindSampler(0, samplerPointClamp);
-			glBindSampler(1, samplerPointClamp);
-			glBindSampler(2, samplerShadowPCF);
-			glBindSampler(3, samplerShadowDepth);
-			glBindSampler(4, samplerPointRepeat);
-
-			glDisable(GL_DEPTH_TEST); // also disables depth writes
-			RenderQuad();
-			glEnable(GL_DEPTH_TEST);
+			g_stateCache.Disable(GL_DEPTH_TEST); // also disables depth writes
+			// in lower resolution into level of bufShadowLowRes, upsampled below
+			const U32 levelLowRes = g_downscaleShadow == 4 ? 1 : 0;
+			// result of previous frame becomes history of this one
+			std::swap(bufShadowDeferred, bufShadowDeferredPrev);
+			glNamedFramebufferTexture(fboShadowDeferred, GL_COLOR_ATTACHMENT0, bufShadowDeferred, 0);
+
+			// without TAA bufDepthPrev isn't depth of previous frame, so history can't be validated
+			const U32 interleaveShadows = g_tAA ? g_interleaveShadows : 1;
+			// fragment pass and passes of tiled shadows share shadowDeferred.gl
+			auto SetUniformsShadow = [&](const Shader& rPass, Bool filtering) {
+				rPass.SetVec3("WsDirLight", -wsDirLight);	// notice "-"
+				rPass.SetFloatArr("AVsFarCascade", aVsFarCascade.data(), g_kNumCascades);
+				rPass.SetMat4("ReferenceShadowMatrix", referenceMatrix);
+				rPass.SetVec3Arr("AScaleCascade", aScaleCascade.data(), aScaleCascade.size());
+				rPass.SetVec3Arr("AOffsetCascade", aOffsetCascade.data(), aOffsetCascade.size());
+				rPass.SetVec4Arr("ARectCascade", aRectCascade.data(), aRectCascade.size());
+
+				rPass.SetFloat("Bias", g_bias);
+				rPass.SetFloat("ScaleNormalOffsetBias", g_scaleNormalOffsetBias);
+				rPass.SetFloat("SizeFilter", g_sizeFilterShadow);
+				rPass.SetMat4("InvViewProj", glm::inverse(projection* view));
+				rPass.SetFloat("Near", nearPlane);
+				rPass.SetBool("OctahedralNormals", gBuffer.IsOctahedral());
+				rPass.SetInt("Downscale", g_downscaleShadow);
+				rPass.SetInt("Interleave", I32(interleaveShadows));
+				rPass.SetInt("IndexFrame", I32(frameCount % 4));
+				if (filtering) {
+					rPass.SetFloat("WidthLight", g_widthLight);
+					// by evaluations of cell instead of frames, so interleaved cells get all 6 rotations of disc as well
+					rPass.SetFloat("RadRotationTemporal", GetRadRodationTemporal(frameCount / interleaveShadows));
+					rPass.SetBool("EnableEvsm", g_enableEvsm);
+				}
+			};
+
+			g_stateCache.BindTextureUnit(0, gBuffer.GetNormal());
+			g_stateCache.BindTextureUnit(1, bufDepth);
+			g_stateCache.BindTextureUnit(2, bufDepthShadow);
+			g_stateCache.BindTextureUnit(3, bufDepthShadow);
+			g_stateCache.BindTextureUnit(4, bufBlueNoise);
+			g_stateCache.BindTextureUnit(5, shadowMapMinMax.GetTexture());
+			g_stateCache.BindTextureUnit(6, shadowMapEvsm.GetTexture());
+			g_stateCache.BindTextureUnit(7, bufShadowDeferredPrev);
+			g_stateCache.BindTextureUnit(8, gBuffer.GetVelocity());
+			g_stateCache.BindTextureUnit(9, bufDepthPrev);	// swapped after TAA, so still of previous frame
+
+			g_stateCache.BindSampler(0, samplerPointClamp);
+			g_stateCache.BindSampler(1, samplerPointClamp);
+			g_stateCache.BindSampler(2, samplerShadowPCF);
+			g_stateCache.BindSampler(3, samplerShadowDepth);
+			g_stateCache.BindSampler(4, samplerPointRepeat);
+			g_stateCache.BindSampler(5, 0); // texelFetch of levels, mipmap filter of texture keeps them in range
+			g_stateCache.BindSampler(6, samplerTrilinearClamp);
+			g_stateCache.BindSampler(7, samplerLinearClamp);
+			g_stateCache.BindSampler(8, samplerPointClamp);
+			g_stateCache.BindSampler(9, samplerPointClamp);
+
+			gBuffer.BeginPass(GBuffer::Pass::SHADOW_DEFERRED);
+			if (g_enableTiledShadows) {
+				const std::vector<Shader>& rAPass = tiledShadows.GetPasses();
+				for (U32 i = 0; i < rAPass.size(); i++)
+					SetUniformsShadow(rAPass[i], TiledShadows::IsFiltering(i));
+				if (g_downscaleShadow == 1)
+					tiledShadows.Evaluate(bufShadowDeferred, 0, g_kWScreen, g_kHScreen);
+				else
+					tiledShadows.Evaluate(bufShadowLowRes, levelLowRes, g_kWScreen / g_downscaleShadow, g_kHScreen / g_downscaleShadow);
+			} else {
+				if (g_downscaleShadow == 1) {
+					g_stateCache.BindFramebuffer(fboShadowDeferred);
+				} else {
+					glNamedFramebufferTexture(fboShadowLowRes, GL_COLOR_ATTACHMENT0, bufShadowLowRes, levelLowRes);
+					g_stateCache.BindFramebuffer(fboShadowLowRes);
+				}
+				g_stateCache.Viewport(0, 0, g_kWScreen / g_downscaleShadow, g_kHScreen / g_downscaleShadow);
+				passShadowDeferred.Use();
+				SetUniformsShadow(passShadowDeferred, true);
+				RenderQuad();
+			}
+			g_stateCache.Viewport(0, 0, g_kWScreen, g_kHScreen); // passes below expect it
+			if (g_downscaleShadow != 1) {
+				g_stateCache.BindFramebuffer(fboShadowDeferred);
+				passShadowUpsample.Use();
+				passShadowUpsample.SetInt("Downscale", g_downscaleShadow);
+				passShadowUpsample.SetInt("LevelLowRes", levelLowRes);
+				passShadowUpsample.SetFloat("Near", nearPlane);
+				g_stateCache.BindTextureUnit(0, bufShadowLowRes);
+				g_stateCache.BindTextureUnit(1, bufDepth);
+				g_stateCache.BindSampler(0, 0); // level 1 is read too
+				g_stateCache.BindSampler(1, samplerPointClamp);
+				RenderQuad();
+			}
+			gBuffer.EndPass(GBuffer::Pass::SHADOW_DEFERRED);
 		}
 		// deffered shading
 		// ----------------
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, fboDeferred);
-			passShading.Use();
-			passShading.SetVec3("WsPosCamera", g_camera.GetWsPosition());
-
-			passShading.SetVec3("WsDirLight", -wsDirLight);	// notice "-"
-			passShading.SetVec3("ColorDirLight", Vec3(3));
-			
-			passShading.SetMat4("InvViewProj", glm::inverse(projection* view));
-			passShading.SetFloat("Near", nearPlane);
-			passShading.SetBool("EnableAO", g_enableAO);
-			glBindTextureUnit(0, bufDiffuseSpec);
-			glBindTextureUnit(1, bufNormal);
-			glBindTextureUnit(2, bufDepth);
-			glBindTextureUnit(3, bufShadowDeferred);
-			glBindTextureUnit(4, bufSsaoAccPrev); // swap above
-			glBindSampler(0, samplerPointClamp);
-			glBindSampler(1, samplerPointClamp);
-			glBindSampler(2, samplerPointClamp);
-			glBindSampler(3, samplerLinearClamp);
-			glBindSampler(4, samplerPointClamp);
+			if (clusteredLights.GetNumLights() != g_numLocalLights)
+				clusteredLights.SetLights(std::vector<ClusteredLights::Light>(aLocalLight.begin(), aLocalLight.begin() + g_numLocalLights));
+			clusteredLights.Cull(view, projection);
+
+			// fragment pass and kernels of tiled shading share shading.gl
+			// only uniforms kernel declares, fragment pass declares all of them
+			auto SetUniformsShading = [&](const Shader& rPass, const TiledShading::Uniforms& rUniforms) {
+				rPass.SetVec3("ColorSky", g_kColorSky);
+				if (rUniforms.m_surface) {
+					rPass.SetVec3("WsPosCamera", g_camera.GetWsPosition());
+					rPass.SetMat4("InvViewProj", glm::inverse(projection * view));
+					rPass.SetFloat("Near", nearPlane);
+					rPass.SetBool("OctahedralNormals", gBuffer.IsOctahedral());
+					clusteredLights.Bind(rPass);
+				}
+				if (rUniforms.m_sun) {
+					rPass.SetVec3("WsDirLight", -wsDirLight);	// notice "-"
+					rPass.SetVec3("ColorDirLight", Vec3(3));
+				}
+				if (rUniforms.m_ao) {
+					rPass.SetBool("EnableAO", g_enableAO);
+					rPass.SetInt("LayoutGtao", I32(g_layoutGtao));
+				}
+			};
+			g_stateCache.BindTextureUnit(0, gBuffer.GetDiffuseSpec());
+			g_stateCache.BindTextureUnit(1, gBuffer.GetNormal());
+			g_stateCache.BindTextureUnit(2, bufDepth);
+			g_stateCache.BindTextureUnit(3, bufShadowDeferred);
+			g_stateCache.BindTextureUnit(4, gtaoBuffer.GetAccumulationPrev()); // swap above
+			g_stateCache.BindSampler(0, samplerPointClamp);
+			g_stateCache.BindSampler(1, samplerPointClamp);
+			g_stateCache.BindSampler(2, samplerPointClamp);
+			g_stateCache.BindSampler(3, samplerLinearClamp);
+			g_stateCache.BindSampler(4, samplerPointClamp);
 			
-			glDisable(GL_DEPTH_TEST); // also disables depth writes
-			RenderQuad();
-			glEnable(GL_DEPTH_TEST);
+			gBuffer.BeginPass(GBuffer::Pass::SHADING);
+			if (g_enableTiledShading) {
+				const std::vector<Shader>& rAKernel = tiledShading.GetKernels();
+				for (U32 i = 0; i < rAKernel.size(); i++)
+					SetUniformsShading(rAKernel[i], TiledShading::GetUniforms(TiledShading::Kernel(i)));
+				tiledShading.Shade(bufHdr, bufDiffuseLight, g_enableAO);
+			} else {
+				g_stateCache.BindFramebuffer(fboDeferred);
+				passShading.Use();
+				SetUniformsShading(passShading, TiledShading::Uniforms());
+				RenderQuad();
+			}
+			gBuffer.EndPass(GBuffer::Pass::SHADING);
 		}
 		// eye adaptation
 		// --------------
@@ -567,23 +933,23 @@ int main() {
 		// apply exposure, tone mapping and gamma correction
 		// -------------------------------------------------
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, fboBack);
+			g_stateCache.BindFramebuffer(fboBack);
 
-			glBindSampler(3, 0); // to avoid warning about PCF sampler binded (above) do depth texture and using non shadow sampler in shader (0x824e)
+			g_stateCache.BindSampler(3, 0); // to avoid warning about PCF sampler binded (above) do depth texture and using non shadow sampler in shader (0x824e)
 			if (g_showShadowMap) {
-				glBindTextureUnit(3, bufDepthShadow);
-				glBindSampler(3, samplerShadowDepth);
-				passExposureTone.SetUInt("IdxCascade", g_cascadeIdx);
+				g_stateCache.BindTextureUnit(3, bufDepthShadow);
+				g_stateCache.BindSampler(3, samplerShadowDepth);
+				passExposureTone.SetVec4("RectShadowMap", aRectCascade[g_cascadeIdx]);
 			} else if (g_showAO) {
-				glBindTextureUnit(0, bufSsaoAccPrev); // swap above
-				glBindSampler(0, samplerPointClamp);
+				g_stateCache.BindTextureUnit(0, gtaoBuffer.GetAccumulationPrev()); // swap above
+				g_stateCache.BindSampler(0, samplerPointClamp);
 			} else {
-				glBindTextureUnit(0, bufHdr);
-				glBindTextureUnit(1, bufDiffuseLight);
-				glBindTextureUnit(2, bufDiffuseLightSingleValue);
-				glBindSampler(0, samplerPointClamp);
-				glBindSampler(1, samplerPointClamp);
-				glBindSampler(2, samplerPointClamp);
+				g_stateCache.BindTextureUnit(0, bufHdr);
+				g_stateCache.BindTextureUnit(1, bufDiffuseLight);
+				g_stateCache.BindTextureUnit(2, bufDiffuseLightSingleValue);
+				g_stateCache.BindSampler(0, samplerPointClamp);
+				g_stateCache.BindSampler(1, samplerPointClamp);
+				g_stateCache.BindSampler(2, samplerPointClamp);
 			}
 			passExposureTone.SetBool("ShowShadowMap", g_showShadowMap);
 			passExposureTone.SetBool("ShowAO", g_showAO);
@@ -595,50 +961,64 @@ int main() {
 			passExposureTone.SetFloat("CrossTalkCoefficient", kWhitePoint * (kWhitePoint - 1));
 
 			passExposureTone.Use();
-			glEnable(GL_FRAMEBUFFER_SRGB);
+			g_stateCache.Enable(GL_FRAMEBUFFER_SRGB);
 			RenderQuad();
-			glDisable(GL_FRAMEBUFFER_SRGB);
 		}
 		// TAA
 		// ---
 		if (g_tAA) {
-			glBindFramebuffer(GL_FRAMEBUFFER, fboTaa);
+			g_stateCache.BindFramebuffer(fboTaa);
 			glNamedFramebufferTexture(fboTaa, GL_COLOR_ATTACHMENT0, bufLdrSrgbAccCurr, 0);
 			passTaa.Use();
 			passTaa.SetFloat("RateOfChange", g_rateOfChangeTAA);
 			passTaa.SetVec4("Scaling", Vec4(g_kWScreen, g_kHScreen, 1. / g_kWScreen, 1. / g_kHScreen));
 			passTaa.SetFloat("Near", nearPlane);
-			glBindTextureUnit(0, bufLdrSrgb);
-			glBindTextureUnit(1, bufLdrSrgbAccPrev);
-			glBindTextureUnit(2, bufVelocity);
-			glBindTextureUnit(3, bufDepth);
-			glBindTextureUnit(4, bufDepthPrev);
-			glBindSampler(0, samplerPointClamp);
-			glBindSampler(1, samplerLinearClamp);
-			glBindSampler(2, samplerPointClamp);
-			glBindSampler(3, samplerPointClamp);
-			glBindSampler(4, samplerPointClamp);
-			glEnable(GL_FRAMEBUFFER_SRGB);
+			g_stateCache.BindTextureUnit(0, bufLdrSrgb);
+			g_stateCache.BindTextureUnit(1, bufLdrSrgbAccPrev);
+			g_stateCache.BindTextureUnit(2, gBuffer.GetVelocity());
+			g_stateCache.BindTextureUnit(3, bufDepth);
+			g_stateCache.BindTextureUnit(4, bufDepthPrev);
+			g_stateCache.BindSampler(0, samplerPointClamp);
+			g_stateCache.BindSampler(1, samplerLinearClamp);
+			g_stateCache.BindSampler(2, samplerPointClamp);
+			g_stateCache.BindSampler(3, samplerPointClamp);
+			g_stateCache.BindSampler(4, samplerPointClamp);
+			g_stateCache.Enable(GL_FRAMEBUFFER_SRGB);
+			gBuffer.BeginPass(GBuffer::Pass::TAA);
 			RenderQuad();
-			glDisable(GL_FRAMEBUFFER_SRGB);
+			gBuffer.EndPass(GBuffer::Pass::TAA);
 
 			std::swap(bufLdrSrgbAccCurr, bufLdrSrgbAccPrev);
 			std::swap(bufDepth, bufDepthPrev);
 		}
 		// pass through to back buffer
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			g_stateCache.BindFramebuffer(0);
 			if (g_tAA)
-				glBindTextureUnit(0, bufLdrSrgbAccPrev); // swap above
+				g_stateCache.BindTextureUnit(0, bufLdrSrgbAccPrev); // swap above
 			else
-				glBindTextureUnit(0, bufLdrSrgb);
-			glBindSampler(0, samplerPointClamp);
+				g_stateCache.BindTextureUnit(0, bufLdrSrgb);
+			g_stateCache.BindSampler(0, samplerPointClamp);
 			passPassThrough.Use();
-			glEnable(GL_FRAMEBUFFER_SRGB);
+			g_stateCache.Enable(GL_FRAMEBUFFER_SRGB);
 			RenderQuad();
-			glDisable(GL_FRAMEBUFFER_SRGB);
 		}
 
+		g_stateCache.EndFrame();
+		if (g_printStateStats)
+			g_stateCache.PrintStats();
+		g_profiler.EndFrame();
+		if (g_printCpuTimings)
+			g_profiler.PrintStats();
+		if (g_printTextureStreaming)
+			rTextureStreamer.PrintStats();
+		gBuffer.EndFrame();
+		if (g_printGBuffer)
+			gBuffer.PrintStats();
+		gtaoBuffer.EndFrame();
+		if (g_printGtao)
+			gtaoBuffer.PrintStats();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
 		if (g_kVSync)
@@ -649,11 +1029,11 @@ int main() {
 		glfwPollEvents();
 	}
 
-	glfwTerminate();
-	return 0;
+	// decoding jobs write into staging memory, which goes away with context
+	rTextureStreamer.Finish();
 }
 
-std::array<Mat4, g_kNumCascades> CalculateCascadeViewProj(const std::array<F32, g_kNumCascades + 1> & aLimitCascade, const Camera & camera, const F32 sShadowMap, const Vec3 wsDirLight) {
+std::array<Mat4, g_kNumCascades> CalculateCascadeViewProj(const std::array<F32, g_kNumCascades + 1> & aLimitCascade, const Camera & camera, const std::array<U32, g_kNumCascades> & aSizeCascade, const Vec3 wsDirLight) {
 	std::array<Mat4, g_kNumCascades> aViewProj;
 
 	const Mat4 invView = glm::inverse(camera.GetViewMatrix());
@@ -720,6 +1100,7 @@ std::array<Mat4, g_kNumCascades> CalculateCascadeViewProj(const std::array<F32,
 		// (real texture space is <0, size>, not <-size/2, size/2>).
 		// Then we round, take offset, go back to <-1, 1> and finally add translation in x and y
 		// so we don't have subpixel movement
+		const F32 sShadowMap = F32(aSizeCascade[i]);
 		const Vec2 fakeTextureSpaceShadowOrigin = (proj * view * Vec4(0, 0, 0, 1)) / 2.f * sShadowMap;
 		const Vec2 fakeTextureSpaceRoundedOrigin = glm::round(fakeTextureSpaceShadowOrigin);
 		const Vec2 ndcRoundedOffset = (fakeTextureSpaceRoundedOrigin - fakeTextureSpaceShadowOrigin) * 2.f / sShadowMap;
@@ -753,6 +1134,33 @@ std::array<F32, g_kNumCascades + 1> CalculateVsLimitsCascade(const F32 nearPlane
 	return limitsCascade;
 }
 
+std::vector<ClusteredLights::Light> CreateLocalLights(Vec3 wsMin, Vec3 wsMax, U32 numLights)
+{
+	std::mt19937 generator(7); // the same lights every run
+	std::uniform_real_distribution<F32> distribution(0, 1);
+	auto Random = [&]() { return distribution(generator); };
+	const Vec3 wsExtent = wsMax - wsMin;
+	std::vector<ClusteredLights::Light> aLight(numLights);
+	for (U32 i = 0; i < numLights; i++) {
+		ClusteredLights::Light& rLight = aLight[i];
+		// lower half, where floors and arcades are
+		rLight.m_wsPosition = wsMin + wsExtent * Vec3(Random(), Random() * 0.5f, Random());
+		rLight.m_radius = glm::length(wsExtent) * glm::mix(0.02f, 0.05f, Random());
+		rLight.m_color = glm::normalize(Vec3(Random(), Random(), Random()) + 0.2f) * 2.f;
+		if (i % 4 == 3) {
+			// spot looking down
+			rLight.m_wsDirection = glm::normalize(Vec3(Random() - 0.5f, -1, Random() - 0.5f));
+			rLight.m_cosOuter = cosf(glm::radians(glm::mix(20.f, 45.f, Random())));
+			rLight.m_cosInner = glm::mix(rLight.m_cosOuter, 1.f, 0.3f);
+		} else {
+			rLight.m_wsDirection = Vec3(0, -1, 0);
+			rLight.m_cosOuter = -2;
+			rLight.m_cosInner = -1;
+		}
+	}
+	return aLight;
+}
+
 Vec4 CalculateToneMappingParamsLottes(F32 whitePoint)
 {
 	// from https://github.com/Opioid/tonemapper/blob/master/tonemapper.py
@@ -805,10 +1213,58 @@ void CallbackKeyboard(GLFWwindow* window, I32 key, I32 scancode, I32 action, I32
 		g_enableNormalMapping = !g_enableNormalMapping;
 	if (key == GLFW_KEY_Z)
 		g_tAA = !g_tAA;
+	if (key == GLFW_KEY_P)
+		g_enableDepthPrepass = !g_enableDepthPrepass;
+	if (key == GLFW_KEY_J)
+		g_enableDrawSorting = !g_enableDrawSorting;
+	if (key == GLFW_KEY_C)
+		g_enableTiledShading = !g_enableTiledShading;
+	if (key == GLFW_KEY_X)
+		g_downscaleShadow = g_downscaleShadow == 4 ? 1 : g_downscaleShadow * 2;
+	if (key == GLFW_KEY_M)
+		g_enableTiledShadows = !g_enableTiledShadows;
+	if (key == GLFW_KEY_F)
+		g_enableEvsm = !g_enableEvsm;
+	if (key == GLFW_KEY_1)
+		g_enableShadowCache = !g_enableShadowCache;
+	if (key == GLFW_KEY_2)
+		g_layoutGtao = GtaoBuffer::Layout((U32(g_layoutGtao) + 1) % U32(GtaoBuffer::Layout::COUNT));
+	if (key == GLFW_KEY_3)
+		g_printGtao = !g_printGtao;
+	if (key == GLFW_KEY_4)
+		g_enableAdaptiveAO = !g_enableAdaptiveAO;
+	if (key == GLFW_KEY_5)
+		g_interleaveAO = g_interleaveAO == 4 ? 1 : g_interleaveAO * 2;
+	if (key == GLFW_KEY_6)
+		g_interleaveShadows = g_interleaveShadows == 4 ? 1 : g_interleaveShadows * 2;
+	if (key == GLFW_KEY_LEFT_BRACKET)
+		g_numLocalLights = g_numLocalLights > 16 ? g_numLocalLights / 2 : 0;
+	if (key == GLFW_KEY_RIGHT_BRACKET)
+		g_numLocalLights = std::min(std::max(g_numLocalLights * 2, 16u), ClusteredLights::kMaxLights);
 	if (key == GLFW_KEY_F1)
 		g_enableAO = !g_enableAO;
 	if (key == GLFW_KEY_F2)
 		g_showAO = !g_showAO;
+	if (key == GLFW_KEY_F3)
+		g_printStateStats = !g_printStateStats;
+	if (key == GLFW_KEY_F4)
+		g_enableLod = !g_enableLod;
+	if (key == GLFW_KEY_F5)
+		g_enableMeshletCulling = !g_enableMeshletCulling;
+	if (key == GLFW_KEY_F6)
+		g_enableSdsm = !g_enableSdsm;
+	if (key == GLFW_KEY_F7)
+		g_enableOcclusionCpu = !g_enableOcclusionCpu;
+	if (key == GLFW_KEY_F8)
+		g_printCpuTimings = !g_printCpuTimings;
+	if (key == GLFW_KEY_F9)
+		g_printTextureStreaming = !g_printTextureStreaming;
+	if (key == GLFW_KEY_F10)
+		g_layoutGBuffer = GBuffer::Layout((U32(g_layoutGBuffer) + 1) % U32(GBuffer::Layout::COUNT));
+	if (key == GLFW_KEY_F11)
+		g_printGBuffer = !g_printGBuffer;
+	if (key == GLFW_KEY_F12)
+		g_enableVisibilityBuffer = !g_enableVisibilityBuffer;
 }
 
 void CallbackMessage(GLE source, GLE type, GLU id, GLE severity, GLS length,
@@ -918,7 +1374,6 @@ void RenderQuad()
 		glVertexArrayAttribBinding(VAO, 0, 0);
 		glVertexArrayAttribBinding(VAO, 1, 0);
 	}
-	glBindVertexArray(VAO);
+	g_stateCache.BindVertexArray(VAO);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
 }
\ No newline at end of file
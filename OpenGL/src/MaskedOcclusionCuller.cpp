@@ -0,0 +1,320 @@
+#include "MaskedOcclusionCuller.h"
+#include "JobSystem.h"	// g_jobSystem
+
+#include <algorithm>	// std::min, std::max, std::swap
+#include <cassert>		// assert
+#include <cmath>		// std::floor, std::ceil, std::abs
+#include <limits>		// std::numeric_limits
+
+#if defined(__AVX2__)
+#include <immintrin.h>	// AVX2 intrinsics
+#endif
+
+namespace {
+	// inside when a * x + b * y + c >= 0
+	struct Edge {
+		F32 m_a;
+		F32 m_b;
+		F32 m_c;
+		F32 m_negInvA;	// -1 / a, 0 when a is 0
+	};
+
+	constexpr F32 kDepthNone = std::numeric_limits<F32>::max();
+
+	// coverage of pixel centers in all rows of tile by triangle, bit i of row covers pixel xTile + i
+	void CoverTile(const Edge (&rAEdge)[3], F32 xTile, F32 yTile, U32* pAMask) {
+		static_assert(MaskedOcclusionCuller::kWidthTile == 32 && MaskedOcclusionCuller::kHeightTile == 8,
+					  "one lane per row, one bit per pixel");
+#if defined(__AVX2__)
+		// one row per lane, x where row crosses edge turns into shift of all ones
+		const __m256 y = _mm256_add_ps(_mm256_set1_ps(yTile + 0.5f), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+		const __m256i ones = _mm256_set1_epi32(-1);
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i bits = _mm256_set1_epi32(32);
+		__m256i mask = ones;
+		for (const Edge& rEdge : rAEdge) {
+			const __m256 byc = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(rEdge.m_b), y), _mm256_set1_ps(rEdge.m_c));
+			if (rEdge.m_a == 0) {
+				mask = _mm256_and_si256(mask, _mm256_castps_si256(_mm256_cmp_ps(byc, _mm256_setzero_ps(), _CMP_GE_OQ)));
+				continue;
+			}
+			// pixel i is inside on one side of t
+			__m256 t = _mm256_sub_ps(_mm256_mul_ps(byc, _mm256_set1_ps(rEdge.m_negInvA)), _mm256_set1_ps(xTile + 0.5f));
+			t = _mm256_min_ps(_mm256_max_ps(t, _mm256_set1_ps(-1)), _mm256_set1_ps(33));
+			if (rEdge.m_a > 0) {
+				// i >= t
+				const __m256i first = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(_mm256_ceil_ps(t)), zero), bits);
+				mask = _mm256_and_si256(mask, _mm256_sllv_epi32(ones, first));
+			} else {
+				// i <= t
+				const __m256i count = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(_mm256_add_ps(_mm256_floor_ps(t), _mm256_set1_ps(1))), zero), bits);
+				mask = _mm256_andnot_si256(_mm256_sllv_epi32(ones, count), mask);
+			}
+		}
+		_mm256_storeu_si256((__m256i*)pAMask, mask);
+#else
+		for (U32 row = 0; row < MaskedOcclusionCuller::kHeightTile; row++) {
+			const F32 y = yTile + row + 0.5f;
+			U32 mask = ~0u;
+			for (const Edge& rEdge : rAEdge) {
+				const F32 byc = rEdge.m_b * y + rEdge.m_c;
+				if (rEdge.m_a == 0) {
+					mask &= byc >= 0 ? ~0u : 0u;
+					continue;
+				}
+				const F32 t = std::min(std::max(byc * rEdge.m_negInvA - (xTile + 0.5f), -1.f), 33.f);
+				if (rEdge.m_a > 0) {
+					const I32 first = std::min(std::max(I32(std::ceil(t)), 0), 32);
+					mask &= U32(~0ull << first);
+				} else {
+					const I32 count = std::min(std::max(I32(std::floor(t)) + 1, 0), 32);
+					mask &= U32((1ull << count) - 1);
+				}
+			}
+			pAMask[row] = mask;
+		}
+#endif
+	}
+
+	// depth is reversed-Z, w is at least near for points in front of near plane
+	Vec4 ClipToScreen(const Vec4& rClip) {
+		const Vec3 ndc = Vec3(rClip) / rClip.w;
+		return Vec4((ndc.x * 0.5f + 0.5f) * MaskedOcclusionCuller::kWidth,
+					(ndc.y * 0.5f + 0.5f) * MaskedOcclusionCuller::kHeight,
+					ndc.z, 1);
+	}
+}
+
+MaskedOcclusionCuller::MaskedOcclusionCuller()
+	: m_aTile(kNumTilesX * kNumTilesY)
+{
+}
+
+void MaskedOcclusionCuller::AddOccluder(const std::vector<Vec3>& rAPosition, const std::vector<U32>& rAIndex) {
+	const U32 baseVertex = U32(m_aPosition.size());
+	m_aPosition.insert(m_aPosition.end(), rAPosition.begin(), rAPosition.end());
+	for (U32 index : rAIndex)
+		m_aIndex.push_back(baseVertex + index);
+}
+
+U32 MaskedOcclusionCuller::AddOccludee(const Vec3& rMsMin, const Vec3& rMsMax) {
+	m_aOccludee.push_back({ rMsMin, rMsMax });
+	m_aVisible.push_back(1);
+	return U32(m_aOccludee.size() - 1);
+}
+
+void MaskedOcclusionCuller::Cull(const Mat4& rModelViewProj) {
+	for (Tile& rTile : m_aTile) {
+		std::fill(std::begin(rTile.m_aMask), std::end(rTile.m_aMask), 0);
+		rTile.m_depth0 = 0;
+		rTile.m_depth1 = kDepthNone;
+	}
+	g_jobSystem.ParallelFor("occlusion CPU: transform and bin", kNumBinningJobs, 1, [&](U32 first, U32 end) {
+		for (U32 idxJob = first; idxJob < end; idxJob++)
+			TransformAndBin(idxJob, rModelViewProj);
+	});
+	// bins own disjoint tiles, so they need no synchronization
+	g_jobSystem.ParallelFor("occlusion CPU: rasterize", kNumBins, 1, [&](U32 first, U32 end) {
+		for (U32 idxBin = first; idxBin < end; idxBin++)
+			RasterizeBin(idxBin);
+	});
+	g_jobSystem.ParallelFor("occlusion CPU: test boxes", U32(m_aOccludee.size()), 64, [&](U32 first, U32 end) {
+		for (U32 i = first; i < end; i++)
+			m_aVisible[i] = IsBoxVisible(m_aOccludee[i], rModelViewProj) ? 1 : 0;
+	});
+}
+
+void MaskedOcclusionCuller::TransformAndBin(U32 idxJob, const Mat4& rModelViewProj) {
+	std::array<std::vector<Triangle>, kNumBins>& rABin = m_aBinPerJob[idxJob];
+	for (std::vector<Triangle>& rBin : rABin)
+		rBin.clear();
+
+	auto Bin = [&](Triangle triangle) {
+		Vec3* pV = triangle.m_aVertex;
+		// counter clockwise, both facings occlude
+		const F32 area = (pV[1].x - pV[0].x) * (pV[2].y - pV[0].y) - (pV[2].x - pV[0].x) * (pV[1].y - pV[0].y);
+		if (std::abs(area) < 1e-6f)
+			return;
+		if (area < 0)
+			std::swap(pV[1], pV[2]);
+
+		// tiles with pixel centers inside bounding box
+		const F32 xMin = std::min(std::min(pV[0].x, pV[1].x), pV[2].x);
+		const F32 xMax = std::max(std::max(pV[0].x, pV[1].x), pV[2].x);
+		const F32 yMin = std::min(std::min(pV[0].y, pV[1].y), pV[2].y);
+		const F32 yMax = std::max(std::max(pV[0].y, pV[1].y), pV[2].y);
+		const I32 pixelXMin = std::max(I32(std::ceil(xMin - 0.5f)), 0);
+		const I32 pixelXMax = std::min(I32(std::floor(xMax - 0.5f)), I32(kWidth) - 1);
+		const I32 pixelYMin = std::max(I32(std::ceil(yMin - 0.5f)), 0);
+		const I32 pixelYMax = std::min(I32(std::floor(yMax - 0.5f)), I32(kHeight) - 1);
+		if (pixelXMin > pixelXMax || pixelYMin > pixelYMax)
+			return;
+		const U32 binXMin = pixelXMin / kWidthTile * kNumBinsX / kNumTilesX;
+		const U32 binXMax = pixelXMax / kWidthTile * kNumBinsX / kNumTilesX;
+		const U32 binYMin = pixelYMin / kHeightTile * kNumBinsY / kNumTilesY;
+		const U32 binYMax = pixelYMax / kHeightTile * kNumBinsY / kNumTilesY;
+		for (U32 binY = binYMin; binY <= binYMax; binY++)
+			for (U32 binX = binXMin; binX <= binXMax; binX++)
+				rABin[binY * kNumBinsX + binX].push_back(triangle);
+	};
+
+	const U32 numTriangles = U32(m_aIndex.size() / 3);
+	const U32 idxFirst = U64(numTriangles) * idxJob / kNumBinningJobs;
+	const U32 idxEnd = U64(numTriangles) * (idxJob + 1) / kNumBinningJobs;
+	for (U32 i = idxFirst; i < idxEnd; i++) {
+		Vec4 aClip[3];
+		for (U32 j = 0; j < 3; j++)
+			aClip[j] = rModelViewProj * Vec4(m_aPosition[m_aIndex[i * 3 + j]], 1);
+
+		// clip against near plane, for infinite reversed-Z projection it's w == z
+		Vec4 aPolygon[4];
+		U32 numVertices = 0;
+		for (U32 j = 0; j < 3; j++) {
+			const Vec4& rA = aClip[j];
+			const Vec4& rB = aClip[(j + 1) % 3];
+			const F32 distanceA = rA.w - rA.z;
+			const F32 distanceB = rB.w - rB.z;
+			if (distanceA >= 0)
+				aPolygon[numVertices++] = rA;
+			if ((distanceA >= 0) != (distanceB >= 0))
+				aPolygon[numVertices++] = glm::mix(rA, rB, distanceA / (distanceA - distanceB));
+		}
+		if (numVertices < 3)
+			continue;
+
+		Triangle triangle;
+		const Vec4 first = ClipToScreen(aPolygon[0]);
+		triangle.m_aVertex[0] = Vec3(first);
+		for (U32 j = 1; j + 1 < numVertices; j++) {
+			triangle.m_aVertex[1] = Vec3(ClipToScreen(aPolygon[j]));
+			triangle.m_aVertex[2] = Vec3(ClipToScreen(aPolygon[j + 1]));
+			Bin(triangle);
+		}
+	}
+}
+
+void MaskedOcclusionCuller::RasterizeBin(U32 idxBin) {
+	const U32 binX = idxBin % kNumBinsX;
+	const U32 binY = idxBin / kNumBinsX;
+	const U32 tileXMin = binX * kNumTilesX / kNumBinsX;
+	const U32 tileXMax = (binX + 1) * kNumTilesX / kNumBinsX - 1;
+	const U32 tileYMin = binY * kNumTilesY / kNumBinsY;
+	const U32 tileYMax = (binY + 1) * kNumTilesY / kNumBinsY - 1;
+	for (const std::array<std::vector<Triangle>, kNumBins>& rABin : m_aBinPerJob)
+		for (const Triangle& rTriangle : rABin[idxBin])
+			RasterizeTriangle(rTriangle, tileXMin, tileXMax, tileYMin, tileYMax);
+}
+
+void MaskedOcclusionCuller::RasterizeTriangle(const Triangle& rTriangle, U32 tileXMin, U32 tileXMax, U32 tileYMin, U32 tileYMax) {
+	const Vec3* pV = rTriangle.m_aVertex;
+	Edge aEdge[3];
+	for (U32 i = 0; i < 3; i++) {
+		const Vec3& rA = pV[i];
+		const Vec3& rB = pV[(i + 1) % 3];
+		Edge& rEdge = aEdge[i];
+		rEdge.m_a = rA.y - rB.y;
+		rEdge.m_b = rB.x - rA.x;
+		rEdge.m_c = -(rEdge.m_a * rA.x + rEdge.m_b * rA.y);
+		rEdge.m_negInvA = rEdge.m_a != 0 ? -1 / rEdge.m_a : 0;
+	}
+
+	// reversed-Z depth is linear in screen space
+	const F32 area = (pV[1].x - pV[0].x) * (pV[2].y - pV[0].y) - (pV[2].x - pV[0].x) * (pV[1].y - pV[0].y);
+	const F32 depthDx = ((pV[1].z - pV[0].z) * (pV[2].y - pV[0].y) - (pV[2].z - pV[0].z) * (pV[1].y - pV[0].y)) / area;
+	const F32 depthDy = ((pV[2].z - pV[0].z) * (pV[1].x - pV[0].x) - (pV[1].z - pV[0].z) * (pV[2].x - pV[0].x)) / area;
+	const F32 depthTriangleMin = std::min(std::min(pV[0].z, pV[1].z), pV[2].z);
+	const F32 depthTriangleMax = std::max(std::max(pV[0].z, pV[1].z), pV[2].z);
+
+	const F32 xMin = std::min(std::min(pV[0].x, pV[1].x), pV[2].x);
+	const F32 xMax = std::max(std::max(pV[0].x, pV[1].x), pV[2].x);
+	const F32 yMin = std::min(std::min(pV[0].y, pV[1].y), pV[2].y);
+	const F32 yMax = std::max(std::max(pV[0].y, pV[1].y), pV[2].y);
+	tileXMin = std::max(tileXMin, U32(std::max(xMin, 0.f)) / kWidthTile);
+	tileXMax = std::min(tileXMax, U32(std::max(xMax, 0.f)) / kWidthTile);
+	tileYMin = std::max(tileYMin, U32(std::max(yMin, 0.f)) / kHeightTile);
+	tileYMax = std::min(tileYMax, U32(std::max(yMax, 0.f)) / kHeightTile);
+
+	for (U32 tileY = tileYMin; tileY <= tileYMax; tileY++) {
+		for (U32 tileX = tileXMin; tileX <= tileXMax; tileX++) {
+			Tile& rTile = m_aTile[tileY * kNumTilesX + tileX];
+			const F32 xTile = F32(tileX * kWidthTile);
+			const F32 yTile = F32(tileY * kHeightTile);
+
+			// depth range of triangle over tile, from plane at tile corners
+			const F32 depthCorner = pV[0].z + (xTile - pV[0].x) * depthDx + (yTile - pV[0].y) * depthDy;
+			const F32 depthX = depthDx * kWidthTile;
+			const F32 depthY = depthDy * kHeightTile;
+			const F32 depthMin = std::max(depthCorner + std::min(depthX, 0.f) + std::min(depthY, 0.f), depthTriangleMin);
+			const F32 depthMax = std::min(depthCorner + std::max(depthX, 0.f) + std::max(depthY, 0.f), depthTriangleMax);
+			// behind reference layer everywhere
+			if (depthMax < rTile.m_depth0)
+				continue;
+
+			U32 aCoverage[kHeightTile];
+			CoverTile(aEdge, xTile, yTile, aCoverage);
+			U32 anyCovered = 0;
+			U32 anyWorking = 0;
+			for (U32 row = 0; row < kHeightTile; row++) {
+				anyCovered |= aCoverage[row];
+				anyWorking |= rTile.m_aMask[row];
+			}
+			if (anyCovered == 0)
+				continue;
+
+			// working layer is dropped when triangle is further from it than it is from reference layer
+			if (anyWorking != 0 && std::abs(depthMin - rTile.m_depth1) > std::abs(rTile.m_depth1 - rTile.m_depth0)) {
+				std::fill(std::begin(rTile.m_aMask), std::end(rTile.m_aMask), 0);
+				rTile.m_depth1 = kDepthNone;
+			}
+			rTile.m_depth1 = std::min(rTile.m_depth1, depthMin);
+			U32 allCovered = ~0u;
+			for (U32 row = 0; row < kHeightTile; row++) {
+				rTile.m_aMask[row] |= aCoverage[row];
+				allCovered &= rTile.m_aMask[row];
+			}
+			// fully covered working layer becomes reference layer
+			if (allCovered == ~0u) {
+				rTile.m_depth0 = std::max(rTile.m_depth0, rTile.m_depth1);
+				rTile.m_depth1 = kDepthNone;
+				std::fill(std::begin(rTile.m_aMask), std::end(rTile.m_aMask), 0);
+			}
+		}
+	}
+}
+
+Bool MaskedOcclusionCuller::IsBoxVisible(const Box& rBox, const Mat4& rModelViewProj) const {
+	Vec2 pixelMin(std::numeric_limits<F32>::max());
+	Vec2 pixelMax(std::numeric_limits<F32>::lowest());
+	F32 depthMax = 0;
+	U32 numBehindNear = 0;
+	for (U32 i = 0; i < 8; i++) {
+		const Vec3 corner((i & 1) ? rBox.m_msMax.x : rBox.m_msMin.x,
+						  (i & 2) ? rBox.m_msMax.y : rBox.m_msMin.y,
+						  (i & 4) ? rBox.m_msMax.z : rBox.m_msMin.z);
+		const Vec4 clip = rModelViewProj * Vec4(corner, 1);
+		if (clip.w < clip.z) {
+			numBehindNear++;
+			continue;
+		}
+		const Vec4 screen = ClipToScreen(clip);
+		pixelMin = glm::min(pixelMin, Vec2(screen));
+		pixelMax = glm::max(pixelMax, Vec2(screen));
+		depthMax = std::max(depthMax, screen.z);
+	}
+	// crossing near plane means box covers camera or gets huge on screen
+	if (numBehindNear > 0)
+		return numBehindNear < 8;
+
+	const I32 xMin = std::max(I32(std::floor(pixelMin.x)), 0);
+	const I32 xMax = std::min(I32(std::ceil(pixelMax.x)), I32(kWidth)) - 1;
+	const I32 yMin = std::max(I32(std::floor(pixelMin.y)), 0);
+	const I32 yMax = std::min(I32(std::ceil(pixelMax.y)), I32(kHeight)) - 1;
+	if (xMin > xMax || yMin > yMax)
+		return false; // outside of screen
+
+	for (I32 tileY = yMin / I32(kHeightTile); tileY <= yMax / I32(kHeightTile); tileY++)
+		for (I32 tileX = xMin / I32(kWidthTile); tileX <= xMax / I32(kWidthTile); tileX++)
+			if (depthMax >= m_aTile[tileY * kNumTilesX + tileX].m_depth0)
+				return true;
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include "types.h"
+
+#include <array>		// std::array
+#include <vector>		// std::vector
+
+// CPU occlusion culling in the style of Masked Software Occlusion Culling (Hasselgren, Andersson, Akenine-Moller).
+// Large occluders are rasterized into low resolution buffer of 32x8 pixel tiles, each with coverage bit
+// per pixel and two depths (reference layer for whole tile, working layer for covered pixels), and boxes of
+// meshes are tested against it before submission, so there is no GPU readback and no frame of latency.
+// Triangles are transformed and binned by jobs of g_jobSystem, then each bin of tiles is rasterized by one job.
+// Depth is reversed-Z (near / w) of infinite projection, so 0 is infinitely far.
+class MaskedOcclusionCuller
+{
+public:
+	static constexpr U32 kWidth = 384;	// multiple of kWidthTile
+	static constexpr U32 kHeight = 216;	// multiple of kHeightTile
+	static constexpr U32 kWidthTile = 32;
+	static constexpr U32 kHeightTile = 8;
+
+	MaskedOcclusionCuller();
+	MaskedOcclusionCuller(const MaskedOcclusionCuller&) = delete;
+	MaskedOcclusionCuller& operator=(const MaskedOcclusionCuller&) = delete;
+
+	// model space triangles, kept on CPU (so pass simplified ones)
+	void AddOccluder(const std::vector<Vec3>& rAPosition, const std::vector<U32>& rAIndex);
+	// model space bounding box, returns index for IsVisible()
+	U32 AddOccludee(const Vec3& rMsMin, const Vec3& rMsMax);
+
+	// rasterizes occluders and tests all occludees, infinite reversed-Z perspective projection only
+	void Cull(const Mat4& rModelViewProj);
+	// result of last Cull()
+	Bool IsVisible(U32 idxOccludee) const { return m_aVisible[idxOccludee] != 0; }
+
+private:
+	static constexpr U32 kNumTilesX = kWidth / kWidthTile;
+	static constexpr U32 kNumTilesY = kHeight / kHeightTile;
+	static constexpr U32 kNumBinsX = 3;
+	static constexpr U32 kNumBinsY = 3;
+	static constexpr U32 kNumBins = kNumBinsX * kNumBinsY;
+	static_assert(kNumTilesX % kNumBinsX == 0 && kNumTilesY % kNumBinsY == 0, "bins should have the same number of tiles");
+
+	struct Tile {
+		U32 m_aMask[kHeightTile];	// bit x of row y covers pixel (x, y) of tile, working layer
+		F32 m_depth0;				// every pixel is at least this close
+		F32 m_depth1;				// every covered pixel is at least this close
+	};
+
+	// screen space, pixels of occlusion buffer and depth
+	struct Triangle {
+		Vec3 m_aVertex[3];
+	};
+
+	struct Box {
+		Vec3 m_msMin;
+		Vec3 m_msMax;
+	};
+
+	// binning is split into this many jobs, each with its own bins
+	static constexpr U32 kNumBinningJobs = 16;
+
+	void TransformAndBin(U32 idxJob, const Mat4& rModelViewProj);
+	void RasterizeBin(U32 idxBin);
+	void RasterizeTriangle(const Triangle& rTriangle, U32 tileXMin, U32 tileXMax, U32 tileYMin, U32 tileYMax);
+	Bool IsBoxVisible(const Box& rBox, const Mat4& rModelViewProj) const;
+
+	std::vector<Vec3> m_aPosition;
+	std::vector<U32> m_aIndex;
+	std::vector<Box> m_aOccludee;
+	std::vector<U8> m_aVisible;
+
+	std::vector<Tile> m_aTile;
+	std::array<std::array<std::vector<Triangle>, kNumBins>, kNumBinningJobs> m_aBinPerJob;
+};
\ No newline at end of file
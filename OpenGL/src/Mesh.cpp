@@ -1,30 +1,83 @@
 #include "Mesh.h"
+#include "GeometryPool.h"				// GeometryPool
+#include "MeshletCuller.h"				// MeshletCuller
+#include "MaskedOcclusionCuller.h"		// MaskedOcclusionCuller
+#include "VisibilityBuffer.h"			// VisibilityBuffer
 
-Mesh::Mesh(const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex, GLU d, GLU s, GLU n, GLU m)
-	: m_numIndicies(rAIndex.size()), m_diffuse(d), m_specular(s), m_normal(n), m_mask(m)
+#include <glm/gtc/matrix_transform.hpp>	// glm::translate, glm::scale
+
+#include <algorithm>					// std::max
+#include <limits>						// std::numeric_limits
+
+F32 Mesh::GetViewDepth(const View& rView) const {
+	if (rView.m_perspective)
+		return glm::distance(rView.m_msPosEye, m_msCenter) - m_msRadius;
+	return glm::dot(m_msCenter, rView.m_msDirView) - m_msRadius;
+}
+
+U32 Mesh::SelectLod(const View& rView) const {
+	if (rView.m_maxErrorPixels <= 0)
+		return 0;
+	F32 pixelsPerUnit = rView.m_pixelsPerUnit;
+	if (rView.m_perspective) {
+		// closest point of bounding sphere, clamped so camera inside sphere doesn't divide by 0
+		const F32 distance = std::max(glm::distance(rView.m_msPosEye, m_msCenter) - m_msRadius, 0.1f);
+		pixelsPerUnit /= distance;
+	}
+	U32 idxLod = 0;
+	while (idxLod + 1 < m_aLod.size() && m_aLod[idxLod + 1].m_error * pixelsPerUnit <= rView.m_maxErrorPixels)
+		idxLod++;
+	return idxLod;
+}
+
+void Mesh::DrawElements(const View& rView, Bool positionOnly, VisibilityBuffer* pVisibility) const {
+	if (rView.m_pOcclusionCuller != nullptr && !rView.m_pOcclusionCuller->IsVisible(m_idxOccludee))
+		return;
+	const U32 idxLod = SelectLod(rView);
+	// meshlet culling covers only LOD 0, coarser LODs are small on screen anyway
+	if (idxLod == 0 && rView.m_idxCull >= 0) {
+		g_stateCache.BindVertexArray(m_pCuller->GetVAO(positionOnly));
+		if (pVisibility != nullptr)
+			pVisibility->SetDrawIndirect(m_pCuller->GetIdxCommand(rView.m_idxCull, m_idxMesh), m_idxFeedback);
+		m_pCuller->DrawIndirect(rView.m_idxCull, m_idxMesh);
+		return;
+	}
+	if (rView.m_culledOnly)
+		return;
+	const MeshLod& rLod = m_aLod[idxLod];
+	g_stateCache.BindVertexArray(positionOnly ? m_pPool->GetVAOPosition() : m_pPool->GetVAO());
+	if (pVisibility != nullptr)
+		pVisibility->SetDraw(rLod.m_firstIndex, m_baseVertex, m_idxFeedback);
+	glDrawElementsBaseVertex(GL_TRIANGLES, rLod.m_numIndices, m_pPool->GetIndexType(),
+							 (void*)(rLod.m_firstIndex * m_pPool->GetIndexSize()), m_baseVertex);
+}
+
+Mat4 Quantization::GetMatDequantize() const {
+	return glm::scale(glm::translate(glm::identity<Mat4>(), m_posMin), m_posExtent);
+}
+
+Mesh::Mesh(GeometryPool& rPool, MeshletCuller& rCuller, MaskedOcclusionCuller& rOcclusionCuller, const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex,
+		   const std::vector<MeshLod>& rALod, const std::vector<Meshlet>& rAMeshlet, const Quantization& rQuantization,
+		   const TextureStreamer& rTextures, U32 idxFeedback, U32 d, U32 s, U32 n, U32 m)
+	: m_pPool(&rPool), m_pCuller(&rCuller), m_aLod(rALod), m_pTextures(&rTextures), m_idxFeedback(idxFeedback),
+	  m_diffuse(d), m_specular(s), m_normal(n), m_mask(m)
 {
-	glCreateBuffers(1, &m_VBO);
-	glCreateBuffers(1, &m_IBO);
-
-	glNamedBufferData(m_VBO, rAVertex.size() * sizeof(rAVertex[0]), rAVertex.data(), GL_STATIC_DRAW);
-	glNamedBufferData(m_IBO, rAIndex.size() * sizeof(rAIndex[0]), rAIndex.data(), GL_STATIC_DRAW);
-
-	glCreateVertexArrays(1, &m_VAO);
-	glVertexArrayVertexBuffer(m_VAO, 0, m_VBO, 0, sizeof(Vertex));
-	glVertexArrayElementBuffer(m_VAO, m_IBO);
-
-	glEnableVertexArrayAttrib(m_VAO, 0);
-	glEnableVertexArrayAttrib(m_VAO, 1);
-	glEnableVertexArrayAttrib(m_VAO, 2);
-	glEnableVertexArrayAttrib(m_VAO, 3);
-
-	glVertexArrayAttribFormat(m_VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, m_position));
-	glVertexArrayAttribFormat(m_VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, m_normal));
-	glVertexArrayAttribFormat(m_VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, m_uv));
-	glVertexArrayAttribFormat(m_VAO, 3, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, m_tangent));
-
-	glVertexArrayAttribBinding(m_VAO, 0, 0);
-	glVertexArrayAttribBinding(m_VAO, 1, 0);
-	glVertexArrayAttribBinding(m_VAO, 2, 0);
-	glVertexArrayAttribBinding(m_VAO, 3, 0);
+	assert(!m_aLod.empty() && m_aLod.size() <= kMaxLods);
+	Vec3 posMin(std::numeric_limits<F32>::max());
+	Vec3 posMax(std::numeric_limits<F32>::lowest());
+	for (const Vertex& rVertex : rAVertex) {
+		posMin = glm::min(posMin, rVertex.m_position);
+		posMax = glm::max(posMax, rVertex.m_position);
+	}
+	m_idxOccludee = rOcclusionCuller.AddOccludee(posMin, posMax);
+	m_msCenter = (posMin + posMax) * 0.5f;
+	m_msRadius = 0;
+	for (const Vertex& rVertex : rAVertex)
+		m_msRadius = std::max(m_msRadius, glm::distance(m_msCenter, rVertex.m_position));
+
+	const GeometryPool::Range range = rPool.Add(rAVertex, rAIndex, rQuantization);
+	m_baseVertex = range.m_baseVertex;
+	for (MeshLod& rLod : m_aLod)
+		rLod.m_firstIndex += range.m_firstIndex;
+	m_idxMesh = rCuller.AddMesh(range, m_aLod[0].m_numIndices, rAMeshlet);
 }
\ No newline at end of file
@@ -2,56 +2,155 @@
 #include <glad/glad.h>	// OGL stuff
 
 #include "types.h"
+#include "StateCache.h"	// g_stateCache
+#include "TextureStreamer.h"	// TextureStreamer
 
 #include <vector>		// std::vector
 
+// import format, packed into VertexPosition and VertexAttributes before upload
 struct Vertex {
 	Vec3 m_position;
 	Vec3 m_normal;
 	Vec2 m_uv;
-	Vec3 m_tangent;
+	Vec4 m_tangent; // w: sign of bitangent, B = cross(N, T) * w
+};
+
+// GPU format, split into two streams decoded by normalized vertex attribute formats,
+// so passes that need only position (shadows, depth) fetch 8 instead of 20 bytes per vertex
+struct VertexPosition {
+	U16 m_position[4];	// unorm relative to model bounds (see Quantization), w is padding
+};
+static_assert(sizeof(VertexPosition) == 8, "VertexPosition should stay tightly packed");
+
+struct VertexAttributes {
+	U32 m_normal;		// snorm 2_10_10_10_REV, w unused
+	U32 m_tangent;		// snorm 2_10_10_10_REV, w sign of bitangent
+	U16 m_uv[2];		// unorm of UV rebased to integer floor of mesh UVs, scaled by 1 / Quantization::m_rangeUv
+};
+static_assert(sizeof(VertexAttributes) == 12, "VertexAttributes should stay tightly packed");
+
+// model wide, so dequantization folds into model matrix and one uniform, instead of per draw state
+struct Quantization {
+	Vec3 m_posMin = Vec3(0);
+	Vec3 m_posExtent = Vec3(1);
+	F32 m_rangeUv = 1;
+
+	// maps unorm position to model space
+	Mat4 GetMatDequantize() const;
+};
+
+// range of shared index buffer
+struct MeshLod {
+	U32 m_firstIndex;
+	U32 m_numIndices;
+	F32 m_error;	// model space distance from LOD 0 surface
+};
+
+// contiguous run of LOD 0 triangles, culled as a whole on GPU, std430 layout
+struct Meshlet {
+	Vec4 m_sphere;		// xyz center, w radius, model space
+	Vec4 m_cone;		// xyz axis, w cutoff: sin of cone spread, 1 when cone can't be backfacing
+	U32 m_firstIndex;	// relative to mesh, absolute in shared index buffer after MeshletCuller::AddMesh()
+	U32 m_numIndices;
+	U32 m_idxMesh;
+	U32 m_padding = 0;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet should match std430 layout in meshletCull.comp");
+
+class GeometryPool;
+class MeshletCuller;
+class MaskedOcclusionCuller;
+class VisibilityBuffer;
+class DrawOrder;
+
+// per view inputs of draw decisions
+struct View {
+	Mat4 m_modelViewProj = Mat4(1);		// model space (not quantized) to clip space
+	Vec3 m_msPosEye = Vec3(0);			// perspective only
+	Vec3 m_msDirView = Vec3(0, 0, -1);	// orthographic only
+	F32 m_pixelsPerUnit = 0;			// perspective: at distance 1, orthographic: everywhere
+	F32 m_maxErrorPixels = 1;			// LOD is picked so error stays below it, 0 forces LOD 0
+	Bool m_perspective = true;
+	I32 m_idxCull = -1;					// slot of MeshletCuller results, -1 draws LOD 0 without meshlet culling
+	Bool m_culledOnly = false;			// skips meshes that don't draw through m_idxCull (second draw of the same view)
+	const MaskedOcclusionCuller* m_pOcclusionCuller = nullptr; // skips meshes occluded in its last Cull(), same view only
+	const DrawOrder* m_pDrawOrder = nullptr;	// order of Model draws, same view only
 };
 
 class Mesh
 {
 public:
-	Mesh(const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex, GLU d, GLU s, GLU n, GLU m = 0);
+	static constexpr U32 kMaxLods = 4;
+	static constexpr U32 kNoMask = ~0u;
 
-	void DrawGeometryOnly() const {
-		glBindVertexArray(m_VAO);
-		glDrawElements(GL_TRIANGLES, m_numIndicies, GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+	// LODs index the same vertices and follow each other in rAIndex, finest first,
+	// meshlets cover LOD 0, bounding box becomes occludee of rOcclusionCuller,
+	// textures are ids in rTextures, draws write their feedback into slot idxFeedback
+	Mesh(GeometryPool& rPool, MeshletCuller& rCuller, MaskedOcclusionCuller& rOcclusionCuller, const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex,
+		 const std::vector<MeshLod>& rALod, const std::vector<Meshlet>& rAMeshlet, const Quantization& rQuantization,
+		 const TextureStreamer& rTextures, U32 idxFeedback, U32 d, U32 s, U32 n, U32 m = kNoMask);
+
+	U32 SelectLod(const View& rView) const;
+	// closest point of bounding sphere, from eye (perspective) or along direction of view (orthographic)
+	F32 GetViewDepth(const View& rView) const;
+	// feedback slot, there is one per material
+	U32 GetMaterial() const { return m_idxFeedback; }
+
+	// reads only position stream
+	void DrawPositionOnly(const View& rView) const {
+		DrawElements(rView, true);
 	}
 
-	void Draw() const {
+	// geometry pass, writes texture streaming feedback
+	void Draw(const View& rView) const {
 		BindBasicTextures();
-		assert(m_mask == 0);
-		DrawGeometryOnly();
+		assert(m_mask == kNoMask);
+		DrawElements(rView, false);
 	}
 
-	void DrawWithMask() const {
+	// geometry pass, writes texture streaming feedback
+	void DrawWithMask(const View& rView) const {
 		BindBasicTextures();
-		assert(m_mask != 0);
-		glBindTextureUnit(4, m_mask);
-		DrawGeometryOnly();
+		assert(m_mask != kNoMask);
+		g_stateCache.BindTextureUnit(4, m_pTextures->GetTexture(m_mask));
+		DrawElements(rView, false);
+	}
+
+	void DrawWithMaskOnly(const View& rView) const {
+		assert(m_mask != kNoMask);
+		g_stateCache.BindTextureUnit(0, m_pTextures->GetTexture(m_mask));
+		DrawElements(rView, false);
 	}
 
-	void DrawWithMaskOnly() const {
-		assert(m_mask != 0);
-		glBindTextureUnit(0, m_mask);
-		DrawGeometryOnly();
+	// visibility buffer pass, alpha masked mesh binds its mask like DrawWithMaskOnly(),
+	// material of mesh is its feedback slot
+	void DrawVisibility(const View& rView, VisibilityBuffer& rVisibility) const {
+		if (m_mask != kNoMask)
+			g_stateCache.BindTextureUnit(0, m_pTextures->GetTexture(m_mask));
+		DrawElements(rView, m_mask == kNoMask, &rVisibility);
 	}
 
 private:
+	// pVisibility gets every draw, so it can tell which triangles draw wrote
+	void DrawElements(const View& rView, Bool positionOnly, VisibilityBuffer* pVisibility = nullptr) const;
 	void BindBasicTextures() const {
-		glBindTextureUnit(1, m_diffuse);
-		glBindTextureUnit(2, m_specular);
-		glBindTextureUnit(3, m_normal);
+		g_stateCache.BindTextureUnit(1, m_pTextures->GetTexture(m_diffuse));
+		g_stateCache.BindTextureUnit(2, m_pTextures->GetTexture(m_specular));
+		g_stateCache.BindTextureUnit(3, m_pTextures->GetTexture(m_normal));
+		glUniform1ui(TextureStreamer::kLocationIdxFeedback, m_idxFeedback);
 	}
-	GLS	m_numIndicies;
-	GLU m_diffuse;
-	GLU m_specular;
-	GLU m_normal;
-	GLU m_mask = 0;
-	GLU m_VAO, m_VBO, m_IBO;
+	const GeometryPool* m_pPool;
+	const MeshletCuller* m_pCuller;
+	U32 m_idxMesh;		// in MeshletCuller
+	U32 m_idxOccludee;	// in MaskedOcclusionCuller
+	U32 m_baseVertex;
+	std::vector<MeshLod> m_aLod;
+	Vec3 m_msCenter;	// bounding sphere
+	F32 m_msRadius;
+	const TextureStreamer* m_pTextures;
+	U32 m_idxFeedback;
+	U32 m_diffuse;
+	U32 m_specular;
+	U32 m_normal;
+	U32 m_mask;
 };
\ No newline at end of file
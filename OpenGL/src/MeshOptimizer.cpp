@@ -0,0 +1,626 @@
+#include "MeshOptimizer.h"
+
+#include <glm/geometric.hpp>	// glm::cross, glm::dot, glm::normalize, glm::length
+
+#include <algorithm>			// std::stable_sort, std::sort
+#include <cassert>				// assert
+#include <cmath>				// std::sqrt
+#include <cstring>				// std::memcpy
+#include <limits>				// std::numeric_limits
+#include <numeric>				// std::iota
+#include <unordered_map>		// std::unordered_map, std::unordered_multimap
+
+namespace {
+	constexpr U32 kInvalid = std::numeric_limits<U32>::max();
+
+	// FIFO cache expressed as timestamps: vertex is in cache when it entered less than cacheSize misses ago
+	class CacheFifo {
+	public:
+		CacheFifo(Size numVertices, U32 cacheSize)
+			: m_aTimestamp(numVertices, 0), m_time(cacheSize + 1), m_cacheSize(cacheSize) {}
+
+		// returns true on miss
+		Bool Access(U32 vertex) {
+			if (m_time - m_aTimestamp[vertex] <= m_cacheSize)
+				return false;
+			m_aTimestamp[vertex] = m_time++;
+			return true;
+		}
+
+		void Reset() {
+			m_time += m_cacheSize + 1;
+		}
+	private:
+		std::vector<U32> m_aTimestamp;
+		U32 m_time;
+		U32 m_cacheSize;
+	};
+
+	// vertex -> triangles, in CSR layout
+	struct Adjacency {
+		std::vector<U32> m_aOffset;
+		std::vector<U32> m_aTriangle;
+
+		Adjacency(const std::vector<U32>& rAIndex, Size numVertices)
+			: m_aOffset(numVertices + 1, 0), m_aTriangle(rAIndex.size())
+		{
+			for (U32 index : rAIndex)
+				m_aOffset[index + 1]++;
+			for (Size i = 0; i < numVertices; i++)
+				m_aOffset[i + 1] += m_aOffset[i];
+			std::vector<U32> aCursor(m_aOffset.begin(), m_aOffset.end() - 1);
+			for (Size i = 0; i < rAIndex.size(); i++)
+				m_aTriangle[aCursor[rAIndex[i]]++] = U32(i / 3);
+		}
+	};
+
+	// symmetric 4x4 matrix of sum of squared distances to planes, weighted by area
+	struct Quadric {
+		F64 m_a00 = 0, m_a01 = 0, m_a02 = 0, m_a11 = 0, m_a12 = 0, m_a22 = 0;
+		F64 m_b0 = 0, m_b1 = 0, m_b2 = 0;
+		F64 m_c = 0;
+		F64 m_weight = 0;
+
+		Quadric() = default;
+		// plane dot(n, p) + d = 0
+		Quadric(const Vec3& n, F32 d, F32 weight)
+			: m_a00(weight * n.x * n.x), m_a01(weight * n.x * n.y), m_a02(weight * n.x * n.z),
+			  m_a11(weight * n.y * n.y), m_a12(weight * n.y * n.z), m_a22(weight * n.z * n.z),
+			  m_b0(weight * n.x * d), m_b1(weight * n.y * d), m_b2(weight * n.z * d),
+			  m_c(weight * d * d), m_weight(weight) {}
+
+		Quadric& operator+=(const Quadric& r) {
+			m_a00 += r.m_a00; m_a01 += r.m_a01; m_a02 += r.m_a02;
+			m_a11 += r.m_a11; m_a12 += r.m_a12; m_a22 += r.m_a22;
+			m_b0 += r.m_b0; m_b1 += r.m_b1; m_b2 += r.m_b2;
+			m_c += r.m_c;
+			m_weight += r.m_weight;
+			return *this;
+		}
+
+		// mean squared distance to accumulated planes
+		F64 Error(const Vec3& p) const {
+			const F64 x = p.x, y = p.y, z = p.z;
+			const F64 error = m_a00 * x * x + 2 * m_a01 * x * y + 2 * m_a02 * x * z
+							+ m_a11 * y * y + 2 * m_a12 * y * z + m_a22 * z * z
+							+ 2 * (m_b0 * x + m_b1 * y + m_b2 * z) + m_c;
+			return m_weight > 0 ? std::max(error, 0.0) / m_weight : 0;
+		}
+	};
+
+	enum class VertexKind : U8 {
+		MANIFOLD,	// free to collapse to any neighbour
+		BORDER,		// collapses only along border edge
+		LOCKED		// attribute seam or non manifold, never moves
+	};
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<U32>& rAIndex, Size numVertices, U32 cacheSize) {
+	VertexCacheStats stats;
+	if (rAIndex.empty() || numVertices == 0)
+		return stats;
+
+	CacheFifo cache(numVertices, cacheSize);
+	U32 misses = 0;
+	for (U32 index : rAIndex)
+		misses += cache.Access(index) ? 1 : 0;
+
+	stats.m_acmr = F32(misses) / F32(rAIndex.size() / 3);
+	stats.m_atvr = F32(misses) / F32(numVertices);
+	return stats;
+}
+
+std::vector<U32> OptimizeVertexCache(std::vector<U32>& rAIndex, Size numVertices, U32 cacheSize) {
+	assert(rAIndex.size() % 3 == 0);
+	const Size numTriangles = rAIndex.size() / 3;
+	std::vector<U32> aHardBoundary;
+	if (numTriangles == 0)
+		return aHardBoundary;
+
+	const Adjacency adjacency(rAIndex, numVertices);
+	std::vector<U32> aLive(numVertices);
+	for (Size i = 0; i < numVertices; i++)
+		aLive[i] = adjacency.m_aOffset[i + 1] - adjacency.m_aOffset[i];
+
+	std::vector<U32> aTimestamp(numVertices, 0);
+	std::vector<Bool> aEmitted(numTriangles, false);
+	std::vector<U32> aDeadEnd;
+	std::vector<U32> aCandidate;
+	std::vector<U32> aOut;
+	aOut.reserve(rAIndex.size());
+
+	U32 time = cacheSize + 1;
+	U32 cursor = 0;
+
+	// pick vertex which was used recently but was not used by emitted triangles yet
+	auto SkipDeadEnd = [&]() {
+		while (!aDeadEnd.empty()) {
+			const U32 vertex = aDeadEnd.back();
+			aDeadEnd.pop_back();
+			if (aLive[vertex] > 0)
+				return vertex;
+		}
+		while (cursor < numVertices) {
+			if (aLive[cursor] > 0)
+				return cursor;
+			cursor++;
+		}
+		return kInvalid;
+	};
+
+	U32 fan = 0;
+	while (fan != kInvalid) {
+		aCandidate.clear();
+		for (U32 i = adjacency.m_aOffset[fan]; i < adjacency.m_aOffset[fan + 1]; i++) {
+			const U32 triangle = adjacency.m_aTriangle[i];
+			if (aEmitted[triangle])
+				continue;
+			for (U32 j = 0; j < 3; j++) {
+				const U32 vertex = rAIndex[triangle * 3 + j];
+				aOut.push_back(vertex);
+				aDeadEnd.push_back(vertex);
+				aCandidate.push_back(vertex);
+				aLive[vertex]--;
+				if (time - aTimestamp[vertex] > cacheSize)
+					aTimestamp[vertex] = time++;
+			}
+			aEmitted[triangle] = true;
+		}
+
+		// next fan: vertex still in cache after emitting its remaining triangles, the oldest one wins
+		U32 best = kInvalid;
+		I32 bestPriority = -1;
+		for (U32 vertex : aCandidate) {
+			if (aLive[vertex] == 0)
+				continue;
+			I32 priority = 0;
+			if (time - aTimestamp[vertex] + 2 * aLive[vertex] <= cacheSize)
+				priority = I32(time - aTimestamp[vertex]);
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				best = vertex;
+			}
+		}
+		if (best == kInvalid) {
+			best = SkipDeadEnd();
+			if (best != kInvalid)
+				aHardBoundary.push_back(U32(aOut.size() / 3));
+		}
+		fan = best;
+	}
+	assert(aOut.size() == rAIndex.size());
+	rAIndex.swap(aOut);
+
+	if (aHardBoundary.empty() || aHardBoundary.front() != 0)
+		aHardBoundary.insert(aHardBoundary.begin(), 0);
+	return aHardBoundary;
+}
+
+void OptimizeOverdraw(std::vector<U32>& rAIndex, const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAHardBoundary,
+					  F32 threshold, U32 cacheSize) {
+	const U32 numTriangles = U32(rAIndex.size() / 3);
+	if (numTriangles == 0)
+		return;
+
+	// soft boundaries: inside every hard cluster, start new cluster as soon as the one being built
+	// has cold cache ACMR within threshold of ACMR of whole hard cluster
+	std::vector<U32> aClusterStart;
+	CacheFifo cache(rAVertex.size(), cacheSize);
+	for (Size i = 0; i < rAHardBoundary.size(); i++) {
+		const U32 start = rAHardBoundary[i];
+		const U32 end = i + 1 < rAHardBoundary.size() ? rAHardBoundary[i + 1] : numTriangles;
+
+		cache.Reset();
+		U32 missesHard = 0;
+		for (U32 t = start; t < end; t++)
+			for (U32 j = 0; j < 3; j++)
+				missesHard += cache.Access(rAIndex[t * 3 + j]) ? 1 : 0;
+		const F32 acmrThreshold = threshold * F32(missesHard) / F32(end - start);
+
+		aClusterStart.push_back(start);
+		cache.Reset();
+		U32 misses = 0;
+		U32 clusterStart = start;
+		for (U32 t = start; t < end; t++) {
+			for (U32 j = 0; j < 3; j++)
+				misses += cache.Access(rAIndex[t * 3 + j]) ? 1 : 0;
+			const U32 clusterTriangles = t - clusterStart + 1;
+			if (t + 1 < end && clusterTriangles > 1 && F32(misses) <= acmrThreshold * F32(clusterTriangles)) {
+				aClusterStart.push_back(t + 1);
+				clusterStart = t + 1;
+				misses = 0;
+				cache.Reset();
+			}
+		}
+	}
+
+	// area weighted centroids and normals
+	auto GetPosition = [&](U32 t, U32 j) { return rAVertex[rAIndex[t * 3 + j]].m_position; };
+	const U32 numClusters = U32(aClusterStart.size());
+	std::vector<Vec3> aCentroid(numClusters, Vec3(0));
+	std::vector<Vec3> aNormal(numClusters, Vec3(0));
+	Vec3 meshCentroid(0);
+	F32 meshArea = 0;
+	for (U32 c = 0; c < numClusters; c++) {
+		const U32 end = c + 1 < numClusters ? aClusterStart[c + 1] : numTriangles;
+		F32 clusterArea = 0;
+		for (U32 t = aClusterStart[c]; t < end; t++) {
+			const Vec3 p0 = GetPosition(t, 0);
+			const Vec3 p1 = GetPosition(t, 1);
+			const Vec3 p2 = GetPosition(t, 2);
+			const Vec3 normalScaled = glm::cross(p1 - p0, p2 - p0); // length is 2x area
+			const F32 area = glm::length(normalScaled) * 0.5f;
+			aCentroid[c] += (p0 + p1 + p2) * (area / 3.f);
+			aNormal[c] += normalScaled;
+			clusterArea += area;
+		}
+		meshCentroid += aCentroid[c];
+		meshArea += clusterArea;
+		aCentroid[c] = clusterArea > 0 ? aCentroid[c] / clusterArea : GetPosition(aClusterStart[c], 0);
+		const F32 lengthNormal = glm::length(aNormal[c]);
+		aNormal[c] = lengthNormal > 0 ? aNormal[c] / lengthNormal : Vec3(0);
+	}
+	meshCentroid = meshArea > 0 ? meshCentroid / meshArea : Vec3(0);
+
+	std::vector<F32> aOutwardness(numClusters);
+	for (U32 c = 0; c < numClusters; c++)
+		aOutwardness[c] = glm::dot(aCentroid[c] - meshCentroid, aNormal[c]);
+
+	std::vector<U32> aOrder(numClusters);
+	std::iota(aOrder.begin(), aOrder.end(), 0);
+	std::stable_sort(aOrder.begin(), aOrder.end(), [&aOutwardness](U32 a, U32 b) {
+		return aOutwardness[a] > aOutwardness[b];
+	});
+
+	std::vector<U32> aOut;
+	aOut.reserve(rAIndex.size());
+	for (U32 c : aOrder) {
+		const U32 end = c + 1 < numClusters ? aClusterStart[c + 1] : numTriangles;
+		aOut.insert(aOut.end(), rAIndex.begin() + aClusterStart[c] * 3, rAIndex.begin() + end * 3);
+	}
+	rAIndex.swap(aOut);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& rAVertex, std::vector<U32>& rAIndex) {
+	std::vector<U32> aRemap(rAVertex.size(), kInvalid);
+	std::vector<Vertex> aOut;
+	aOut.reserve(rAVertex.size());
+	for (U32& rIndex : rAIndex) {
+		if (aRemap[rIndex] == kInvalid) {
+			aRemap[rIndex] = U32(aOut.size());
+			aOut.push_back(rAVertex[rIndex]);
+		}
+		rIndex = aRemap[rIndex];
+	}
+	rAVertex.swap(aOut);
+}
+
+std::vector<U32> SimplifyMesh(const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex,
+							  Size targetNumIndices, F32 maxError, F32& rError) {
+	// relative to extent, so weights and maxError don't depend on mesh size
+	const Size numVertices = rAVertex.size();
+	Vec3 posMin(std::numeric_limits<F32>::max());
+	Vec3 posMax(std::numeric_limits<F32>::lowest());
+	for (const Vertex& rVertex : rAVertex) {
+		posMin = glm::min(posMin, rVertex.m_position);
+		posMax = glm::max(posMax, rVertex.m_position);
+	}
+	const F32 extent = std::max(std::max(posMax.x - posMin.x, posMax.y - posMin.y), std::max(posMax.z - posMin.z, 1e-6f));
+	std::vector<Vec3> aPosition(numVertices);
+	for (Size i = 0; i < numVertices; i++)
+		aPosition[i] = (rAVertex[i].m_position - posMin) / extent;
+
+	// weld vertices split by attributes, topology is analyzed on positions only
+	std::vector<U32> aWeld(numVertices);
+	std::vector<U32> aNumSplit(numVertices, 0);
+	{
+		std::unordered_multimap<U64, U32> positionToVertex;
+		positionToVertex.reserve(numVertices);
+		for (U32 i = 0; i < numVertices; i++) {
+			U32 aBits[3];
+			std::memcpy(&aBits[0], &rAVertex[i].m_position, sizeof(aBits));
+			const U64 hash = (U64(aBits[0]) * 73856093u) ^ (U64(aBits[1]) * 19349663u << 16) ^ (U64(aBits[2]) * 83492791u << 32);
+			aWeld[i] = i;
+			const auto range = positionToVertex.equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it) {
+				if (rAVertex[it->second].m_position == rAVertex[i].m_position) {
+					aWeld[i] = it->second;
+					break;
+				}
+			}
+			if (aWeld[i] == i)
+				positionToVertex.emplace(hash, i);
+			aNumSplit[aWeld[i]]++;
+		}
+	}
+
+	// directed edges of welded mesh, edge without opposite twin lies on border
+	std::vector<VertexKind> aKind(numVertices, VertexKind::MANIFOLD);
+	std::vector<U32> aBorderNext(numVertices, kInvalid);
+	std::vector<U32> aBorderPrev(numVertices, kInvalid);
+	{
+		std::unordered_map<U64, U32> edgeCount;
+		edgeCount.reserve(rAIndex.size());
+		auto GetKey = [](U32 a, U32 b) { return U64(a) << 32 | b; };
+		for (Size t = 0; t < rAIndex.size(); t += 3)
+			for (U32 j = 0; j < 3; j++)
+				edgeCount[GetKey(aWeld[rAIndex[t + j]], aWeld[rAIndex[t + (j + 1) % 3]])]++;
+		for (Size t = 0; t < rAIndex.size(); t += 3) {
+			for (U32 j = 0; j < 3; j++) {
+				const U32 a = rAIndex[t + j];
+				const U32 b = rAIndex[t + (j + 1) % 3];
+				const U32 countForward = edgeCount[GetKey(aWeld[a], aWeld[b])];
+				const auto itBackward = edgeCount.find(GetKey(aWeld[b], aWeld[a]));
+				const U32 countBackward = itBackward != edgeCount.end() ? itBackward->second : 0;
+				if (countForward > 1 || countBackward > 1) {
+					aKind[a] = aKind[b] = VertexKind::LOCKED;
+				} else if (countBackward == 0) {
+					// vertex on two border loops can't slide along both
+					if (aKind[a] != VertexKind::LOCKED)
+						aKind[a] = aBorderNext[a] == kInvalid ? VertexKind::BORDER : VertexKind::LOCKED;
+					if (aKind[b] != VertexKind::LOCKED)
+						aKind[b] = aBorderPrev[b] == kInvalid ? VertexKind::BORDER : VertexKind::LOCKED;
+					aBorderNext[a] = b;
+					aBorderPrev[b] = a;
+				}
+			}
+		}
+		for (U32 i = 0; i < numVertices; i++)
+			if (aNumSplit[aWeld[i]] > 1)
+				aKind[i] = VertexKind::LOCKED;
+	}
+
+	// plane quadrics of triangles plus perpendicular planes through border edges, so borders keep their shape
+	const F32 kWeightBorder = 10;
+	std::vector<Quadric> aQuadric(numVertices);
+	for (Size t = 0; t < rAIndex.size(); t += 3) {
+		const Vec3 p0 = aPosition[rAIndex[t + 0]];
+		const Vec3 p1 = aPosition[rAIndex[t + 1]];
+		const Vec3 p2 = aPosition[rAIndex[t + 2]];
+		const Vec3 normalScaled = glm::cross(p1 - p0, p2 - p0);
+		const F32 area = glm::length(normalScaled);
+		if (area == 0)
+			continue;
+		const Vec3 normal = normalScaled / area;
+		const Quadric quadric(normal, -glm::dot(normal, p0), area);
+		for (U32 j = 0; j < 3; j++)
+			aQuadric[rAIndex[t + j]] += quadric;
+
+		for (U32 j = 0; j < 3; j++) {
+			const U32 a = rAIndex[t + j];
+			const U32 b = rAIndex[t + (j + 1) % 3];
+			if (aBorderNext[a] != b)
+				continue;
+			const Vec3 edge = aPosition[b] - aPosition[a];
+			const F32 length = glm::length(edge);
+			if (length == 0)
+				continue;
+			const Vec3 normalBorder = glm::normalize(glm::cross(edge, normal));
+			const Quadric quadricBorder(normalBorder, -glm::dot(normalBorder, aPosition[a]), length * length * kWeightBorder);
+			aQuadric[a] += quadricBorder;
+			aQuadric[b] += quadricBorder;
+		}
+	}
+
+	// collapsing v0 into v1 replaces attributes of v0 with those of v1
+	const F32 kWeightNormal = 0.05f;
+	const F32 kWeightUv = 0.05f;
+	auto GetCost = [&](U32 v0, U32 v1) {
+		Quadric quadric = aQuadric[v0];
+		quadric += aQuadric[v1];
+		const Vec3 deltaNormal = rAVertex[v0].m_normal - rAVertex[v1].m_normal;
+		const Vec2 deltaUv = rAVertex[v0].m_uv - rAVertex[v1].m_uv;
+		return F32(quadric.Error(aPosition[v1]))
+			 + kWeightNormal * kWeightNormal * glm::dot(deltaNormal, deltaNormal)
+			 + kWeightUv * kWeightUv * glm::dot(deltaUv, deltaUv);
+	};
+	auto CanCollapse = [&](U32 v0, U32 v1) {
+		switch (aKind[v0]) {
+		case VertexKind::MANIFOLD: return true;
+		case VertexKind::BORDER:   return aBorderNext[v0] == v1 || aBorderPrev[v0] == v1;
+		default:				   return false;
+		}
+	};
+
+	struct Collapse {
+		U32 m_v0;
+		U32 m_v1;
+		F32 m_cost;
+	};
+	std::vector<U32> aIndex = rAIndex;
+	std::vector<Collapse> aCollapse;
+	std::vector<U32> aRemap(numVertices);
+	std::vector<Bool> aTouched(numVertices);
+	const F32 maxCost = maxError * maxError;
+	F32 errorSq = 0;
+
+	while (aIndex.size() > targetNumIndices) {
+		// candidates, cheaper direction of every edge
+		aCollapse.clear();
+		for (Size t = 0; t < aIndex.size(); t += 3) {
+			for (U32 j = 0; j < 3; j++) {
+				const U32 a = aIndex[t + j];
+				const U32 b = aIndex[t + (j + 1) % 3];
+				// interior edges are visited twice, from both triangles
+				if (a > b && aBorderNext[a] != b)
+					continue;
+				const Bool ab = CanCollapse(a, b);
+				const Bool ba = CanCollapse(b, a);
+				if (!ab && !ba)
+					continue;
+				const F32 costAb = ab ? GetCost(a, b) : std::numeric_limits<F32>::max();
+				const F32 costBa = ba ? GetCost(b, a) : std::numeric_limits<F32>::max();
+				if (costAb <= costBa)
+					aCollapse.push_back({ a, b, costAb });
+				else
+					aCollapse.push_back({ b, a, costBa });
+			}
+		}
+		if (aCollapse.empty())
+			break;
+		std::sort(aCollapse.begin(), aCollapse.end(), [](const Collapse& a, const Collapse& b) { return a.m_cost < b.m_cost; });
+
+		const Adjacency adjacency(aIndex, numVertices);
+		std::iota(aRemap.begin(), aRemap.end(), 0);
+		std::fill(aTouched.begin(), aTouched.end(), false);
+		// every collapse removes 2 triangles (1 on border), don't overshoot target
+		const Size numTrianglesToRemove = (aIndex.size() - targetNumIndices) / 3;
+		Size numTrianglesRemoved = 0;
+		Size numCollapses = 0;
+		for (const Collapse& rCollapse : aCollapse) {
+			if (rCollapse.m_cost > maxCost || numTrianglesRemoved >= numTrianglesToRemove)
+				break;
+			const U32 v0 = rCollapse.m_v0;
+			const U32 v1 = rCollapse.m_v1;
+			if (aTouched[v0] || aTouched[v1])
+				continue;
+
+			// reject if any triangle around v0 flips or degenerates when v0 moves to v1
+			Bool flips = false;
+			for (U32 i = adjacency.m_aOffset[v0]; i < adjacency.m_aOffset[v0 + 1] && !flips; i++) {
+				const U32 t = adjacency.m_aTriangle[i] * 3;
+				const U32 i0 = aIndex[t + 0], i1 = aIndex[t + 1], i2 = aIndex[t + 2];
+				if (i0 == v1 || i1 == v1 || i2 == v1)
+					continue;
+				const Vec3 p0 = aPosition[i0], p1 = aPosition[i1], p2 = aPosition[i2];
+				const Vec3 normalBefore = glm::cross(p1 - p0, p2 - p0);
+				const Vec3 q0 = i0 == v0 ? aPosition[v1] : p0;
+				const Vec3 q1 = i1 == v0 ? aPosition[v1] : p1;
+				const Vec3 q2 = i2 == v0 ? aPosition[v1] : p2;
+				const Vec3 normalAfter = glm::cross(q1 - q0, q2 - q0);
+				flips = glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter);
+			}
+			if (flips)
+				continue;
+
+			// triangles around v0 change, so its whole one ring waits for next pass
+			for (U32 i = adjacency.m_aOffset[v0]; i < adjacency.m_aOffset[v0 + 1]; i++) {
+				const U32 t = adjacency.m_aTriangle[i] * 3;
+				aTouched[aIndex[t + 0]] = aTouched[aIndex[t + 1]] = aTouched[aIndex[t + 2]] = true;
+			}
+			aRemap[v0] = v1;
+			aQuadric[v1] += aQuadric[v0];
+			if (aKind[v0] == VertexKind::BORDER) {
+				// v1 takes over place of v0 in border loop
+				if (aBorderNext[v0] == v1) {
+					aBorderPrev[v1] = aBorderPrev[v0];
+					if (aBorderPrev[v0] != kInvalid)
+						aBorderNext[aBorderPrev[v0]] = v1;
+				} else {
+					aBorderNext[v1] = aBorderNext[v0];
+					if (aBorderNext[v0] != kInvalid)
+						aBorderPrev[aBorderNext[v0]] = v1;
+				}
+				numTrianglesRemoved += 1;
+			} else {
+				numTrianglesRemoved += 2;
+			}
+			errorSq = std::max(errorSq, rCollapse.m_cost);
+			numCollapses++;
+		}
+		if (numCollapses == 0)
+			break;
+
+		// apply and drop degenerate triangles
+		Size numIndices = 0;
+		for (Size t = 0; t < aIndex.size(); t += 3) {
+			const U32 i0 = aRemap[aIndex[t + 0]];
+			const U32 i1 = aRemap[aIndex[t + 1]];
+			const U32 i2 = aRemap[aIndex[t + 2]];
+			if (i0 == i1 || i1 == i2 || i2 == i0)
+				continue;
+			aIndex[numIndices++] = i0;
+			aIndex[numIndices++] = i1;
+			aIndex[numIndices++] = i2;
+		}
+		aIndex.resize(numIndices);
+	}
+
+	rError = std::sqrt(errorSq) * extent;
+	return aIndex;
+}
+
+std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex) {
+	std::vector<Meshlet> aMeshlet;
+	std::vector<U32> aStamp(rAVertex.size(), kInvalid); // meshlet which last used vertex
+	std::vector<U32> aVertexMeshlet;
+	aVertexMeshlet.reserve(kMeshletMaxVertices);
+
+	auto Finish = [&](U32 firstTriangle, U32 endTriangle) {
+		Meshlet meshlet;
+		meshlet.m_firstIndex = firstTriangle * 3;
+		meshlet.m_numIndices = (endTriangle - firstTriangle) * 3;
+		meshlet.m_idxMesh = 0;
+
+		Vec3 posMin(std::numeric_limits<F32>::max());
+		Vec3 posMax(std::numeric_limits<F32>::lowest());
+		for (U32 vertex : aVertexMeshlet) {
+			posMin = glm::min(posMin, rAVertex[vertex].m_position);
+			posMax = glm::max(posMax, rAVertex[vertex].m_position);
+		}
+		const Vec3 center = (posMin + posMax) * 0.5f;
+		F32 radius = 0;
+		for (U32 vertex : aVertexMeshlet)
+			radius = std::max(radius, glm::length(rAVertex[vertex].m_position - center));
+		meshlet.m_sphere = Vec4(center, radius);
+
+		// axis is average of face normals, cutoff is sine of angle between axis and most divergent normal
+		std::vector<Vec3> aNormal;
+		aNormal.reserve(endTriangle - firstTriangle);
+		Vec3 axis(0);
+		for (U32 t = firstTriangle; t < endTriangle; t++) {
+			const Vec3 p0 = rAVertex[rAIndex[t * 3 + 0]].m_position;
+			const Vec3 p1 = rAVertex[rAIndex[t * 3 + 1]].m_position;
+			const Vec3 p2 = rAVertex[rAIndex[t * 3 + 2]].m_position;
+			const Vec3 normalScaled = glm::cross(p1 - p0, p2 - p0);
+			const F32 length = glm::length(normalScaled);
+			if (length == 0)
+				continue;
+			aNormal.push_back(normalScaled / length);
+			axis += aNormal.back();
+		}
+		const F32 lengthAxis = glm::length(axis);
+		F32 minDot = 1;
+		if (lengthAxis > 0) {
+			axis /= lengthAxis;
+			for (const Vec3& rNormal : aNormal)
+				minDot = std::min(minDot, glm::dot(rNormal, axis));
+		} else {
+			minDot = 0;
+		}
+		// cone wider than hemisphere always has some front faces
+		const F32 cutoff = minDot <= 0 ? 1 : std::sqrt(1 - minDot * minDot);
+		meshlet.m_cone = Vec4(axis, cutoff);
+		aMeshlet.push_back(meshlet);
+	};
+
+	const U32 numTriangles = U32(rAIndex.size() / 3);
+	U32 firstTriangle = 0;
+	for (U32 t = 0; t < numTriangles; t++) {
+		const U32 idxMeshlet = U32(aMeshlet.size());
+		U32 numNew = 0;
+		for (U32 j = 0; j < 3; j++) {
+			const U32 vertex = rAIndex[t * 3 + j];
+			// duplicates inside triangle are counted once
+			Bool seen = aStamp[vertex] == idxMeshlet;
+			for (U32 k = 0; k < j && !seen; k++)
+				seen = rAIndex[t * 3 + k] == vertex;
+			numNew += seen ? 0 : 1;
+		}
+		if (aVertexMeshlet.size() + numNew > kMeshletMaxVertices || t - firstTriangle + 1 > kMeshletMaxTriangles) {
+			Finish(firstTriangle, t);
+			firstTriangle = t;
+			aVertexMeshlet.clear();
+		}
+		for (U32 j = 0; j < 3; j++) {
+			const U32 vertex = rAIndex[t * 3 + j];
+			if (aStamp[vertex] != U32(aMeshlet.size())) {
+				aStamp[vertex] = U32(aMeshlet.size());
+				aVertexMeshlet.push_back(vertex);
+			}
+		}
+	}
+	if (firstTriangle < numTriangles)
+		Finish(firstTriangle, numTriangles);
+	return aMeshlet;
+}
\ No newline at end of file
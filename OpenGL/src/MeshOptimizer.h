@@ -0,0 +1,50 @@
+#pragma once
+#include "types.h"
+#include "Mesh.h"		// Vertex, Meshlet
+
+#include <vector>		// std::vector
+
+// Import time reordering of triangle lists, so GPU does less vertex shading (post transform cache),
+// less pixel shading (overdraw) and less memory traffic (vertex fetch).
+// Order of calls matters: cache -> overdraw -> fetch.
+
+// FIFO size assumed by optimization and analysis
+constexpr U32 kVertexCacheSize = 16;
+
+struct VertexCacheStats {
+	F32 m_acmr = 0;	// average cache miss ratio: transformed vertices per triangle, 0.5 is ideal for big grids, 3 is worst
+	F32 m_atvr = 0;	// average transformed vertex ratio: transformed vertices per vertex, 1 is ideal
+};
+
+// simulates FIFO post transform cache
+VertexCacheStats AnalyzeVertexCache(const std::vector<U32>& rAIndex, Size numVertices, U32 cacheSize = kVertexCacheSize);
+
+// Tipsify (Sander et al. 2007), linear time, returns first triangle of each fan sequence
+// which couldn't continue from vertices in cache (hard boundaries for OptimizeOverdraw())
+std::vector<U32> OptimizeVertexCache(std::vector<U32>& rAIndex, Size numVertices, U32 cacheSize = kVertexCacheSize);
+
+// Splits cache optimized sequence into clusters which can be reordered without raising ACMR above
+// threshold * original and sorts them so clusters facing away from mesh center go first,
+// which approximates front to back order from most view directions
+void OptimizeOverdraw(std::vector<U32>& rAIndex, const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAHardBoundary,
+					  F32 threshold = 1.05f, U32 cacheSize = kVertexCacheSize);
+
+// Reorders vertices in order of first use by index buffer and drops unreferenced ones.
+// When LODs share vertex buffer, pass all of them concatenated, finest first.
+void OptimizeVertexFetch(std::vector<Vertex>& rAVertex, std::vector<U32>& rAIndex);
+
+// Quadric error metric edge collapse (Garland and Heckbert 1997) until number of indices drops to target
+// or next collapse would exceed maxError. Vertices on attribute seams (same position, different
+// normal/UV) stay in place, border vertices slide only along border and attribute differences
+// add penalty to cost, so collapses prefer flat and uniformly mapped areas.
+// maxError is relative to mesh extent, rError returns error reached, in model space.
+std::vector<U32> SimplifyMesh(const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex,
+							  Size targetNumIndices, F32 maxError, F32& rError);
+
+constexpr U32 kMeshletMaxVertices = 64;
+constexpr U32 kMeshletMaxTriangles = 124;
+
+// Splits triangle list into runs of consecutive triangles touching at most kMeshletMaxVertices vertices,
+// so culled meshlet is just a range of index buffer. Call after cache and overdraw optimization,
+// which already keep consecutive triangles close to each other.
+std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& rAVertex, const std::vector<U32>& rAIndex);
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "MeshletCuller.h"
+#include "HiZ.h"				// HiZ
+
+#include <glm/geometric.hpp>	// glm::length
+
+#include <algorithm>			// std::min
+#include <array>				// std::array
+#include <cassert>				// assert
+
+U32 MeshletCuller::AddMesh(const GeometryPool::Range& rRange, U32 numIndicesLod0, const std::vector<Meshlet>& rAMeshlet) {
+	assert(m_bufMeshlet == 0 && "AddMesh() after Upload()");
+	const U32 idxMesh = U32(m_aCommandTemplate.size());
+	for (Meshlet meshlet : rAMeshlet) {
+		meshlet.m_firstIndex += rRange.m_firstIndex;
+		meshlet.m_idxMesh = idxMesh;
+		m_aMeshlet.push_back(meshlet);
+	}
+	m_aCommandTemplate.push_back({ 0, 1, m_numIndicesLod0, I32(rRange.m_baseVertex), 0 });
+	m_numIndicesLod0 += numIndicesLod0;
+	return idxMesh;
+}
+
+void MeshletCuller::Upload(const GeometryPool& rPool) {
+	m_bufIndex = rPool.GetIndexBuffer();
+	m_index16 = rPool.GetIndexType() == GL_UNSIGNED_SHORT;
+
+	glCreateBuffers(1, &m_bufMeshlet);
+	glNamedBufferStorage(m_bufMeshlet, std::max<Size>(m_aMeshlet.size(), 1) * sizeof(Meshlet), m_aMeshlet.data(), 0);
+
+	// everything visible, so first EARLY draws whole frustum
+	const std::vector<U32> aVisibility(std::max<Size>(m_aMeshlet.size(), 1), 1);
+	glCreateBuffers(1, &m_bufVisibility);
+	glNamedBufferStorage(m_bufVisibility, aVisibility.size() * sizeof(U32), aVisibility.data(), 0);
+
+	glCreateBuffers(1, &m_bufIndexCulled);
+	glNamedBufferStorage(m_bufIndexCulled, std::max<Size>(kMaxViews * m_numIndicesLod0, 1) * sizeof(U32), nullptr, 0);
+
+	std::vector<DrawElementsIndirectCommand> aCommandReset;
+	for (U32 i = 0; i < kMaxViews; i++)
+		for (DrawElementsIndirectCommand command : m_aCommandTemplate) {
+			command.m_firstIndex += i * m_numIndicesLod0;
+			aCommandReset.push_back(command);
+		}
+	const Size sizeCommands = std::max<Size>(aCommandReset.size(), 1) * sizeof(DrawElementsIndirectCommand);
+	glCreateBuffers(1, &m_bufCommandReset);
+	glNamedBufferStorage(m_bufCommandReset, sizeCommands, aCommandReset.data(), 0);
+	glCreateBuffers(1, &m_bufCommand);
+	glNamedBufferStorage(m_bufCommand, sizeCommands, aCommandReset.data(), 0);
+
+	m_VAO = rPool.CreateVertexArray(m_bufIndexCulled, false);
+	m_VAOPosition = rPool.CreateVertexArray(m_bufIndexCulled, true);
+}
+
+void MeshletCuller::Cull(const View& rView, CullPhase phase, const HiZ* pHiZ) const {
+	assert(rView.m_idxCull >= 0 && U32(rView.m_idxCull) < kMaxViews);
+	assert(phase == CullPhase::SINGLE || rView.m_perspective);	// Hi-Z test projects spheres for perspective only
+	assert(phase != CullPhase::LATE || pHiZ != nullptr);
+	const U32 numMeshes = U32(m_aCommandTemplate.size());
+	const U32 numMeshlets = U32(m_aMeshlet.size());
+	if (numMeshlets == 0)
+		return;
+
+	// zero index counts of this view
+	const Size sizeCommandsView = numMeshes * sizeof(DrawElementsIndirectCommand);
+	glCopyNamedBufferSubData(m_bufCommandReset, m_bufCommand, rView.m_idxCull * sizeCommandsView, rView.m_idxCull * sizeCommandsView, sizeCommandsView);
+
+	// left, right, bottom, top (Gribb-Hartmann), near and far don't matter for infinite and cascade projections
+	const Mat4& rM = rView.m_modelViewProj;
+	const Vec4 row0(rM[0][0], rM[1][0], rM[2][0], rM[3][0]);
+	const Vec4 row1(rM[0][1], rM[1][1], rM[2][1], rM[3][1]);
+	const Vec4 row3(rM[0][3], rM[1][3], rM[2][3], rM[3][3]);
+	std::array<Vec4, 4> aPlane = { row3 + row0, row3 - row0, row3 + row1, row3 - row1 };
+	for (Vec4& rPlane : aPlane)
+		rPlane /= glm::length(Vec3(rPlane));
+
+	m_passCull.SetVec4Arr("FrustumPlanes", aPlane.data(), GLS(aPlane.size()));
+	m_passCull.SetBool("Perspective", rView.m_perspective);
+	m_passCull.SetVec3("MsPosEye", rView.m_msPosEye);
+	m_passCull.SetVec3("MsDirView", rView.m_msDirView);
+	m_passCull.SetUInt("IdxFirstCommand", rView.m_idxCull * numMeshes);
+	m_passCull.SetUInt("NumMeshlets", numMeshlets);
+	m_passCull.SetBool("Index16", m_index16);
+	m_passCull.SetUInt("Phase", U32(phase));
+	m_passCull.SetMat4("ModelViewProj", rView.m_modelViewProj);
+	m_passCull.Use();
+	if (phase == CullPhase::LATE) {
+		m_passCull.SetVec2("SizeDepth", Vec2(pHiZ->GetWDepth(), pHiZ->GetHDepth()));
+		m_passCull.SetInt("NumLevelsHiZ", HiZ::kNumLevels);
+		g_stateCache.BindTextureUnit(0, pHiZ->GetTexture());
+		g_stateCache.BindSampler(0, 0);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_bufMeshlet);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_bufIndex);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_bufIndexCulled);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_bufCommand);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_bufVisibility);
+	// one work group per meshlet, spread over y when there are more than guaranteed limit of x
+	const U32 kMaxGroupsX = 65535;
+	glDispatchCompute(std::min(numMeshlets, kMaxGroupsX), (numMeshlets + kMaxGroupsX - 1) / kMaxGroupsX, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+}
\ No newline at end of file
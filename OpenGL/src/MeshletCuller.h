@@ -0,0 +1,75 @@
+#pragma once
+#include <glad/glad.h>		// OGL stuff
+
+#include "types.h"
+#include "Mesh.h"			// Meshlet, View
+#include "GeometryPool.h"	// GeometryPool
+#include "Shader.h"			// Shader
+
+#include <vector>			// std::vector
+
+class HiZ;
+
+// Culls meshlets of LOD 0 on GPU for each view (frustum and backface cone). Visible meshlets copy their
+// indices into culled index buffer of the view and add to index count of indirect draw of their mesh,
+// so a partially visible mesh costs only as much as its visible part.
+// One view can also cull occluded meshlets in two phases: EARLY draws meshlets visible last frame,
+// LATE tests the rest against Hi-Z of that depth and draws what turned out visible.
+class MeshletCuller
+{
+public:
+	static constexpr U32 kMaxViews = 6; // camera early, camera late and cascades
+
+	enum class CullPhase : U32 {
+		SINGLE,	// frustum and cone only
+		EARLY,	// also skips meshlets occluded last frame
+		LATE,	// also skips meshlets occluded in Hi-Z or already drawn by EARLY, remembers visibility for next frame
+	};
+
+	MeshletCuller() : m_passCull("meshletCull.comp") {}
+
+	// meshlets come relative to mesh LOD 0, returns index of mesh
+	U32 AddMesh(const GeometryPool::Range& rRange, U32 numIndicesLod0, const std::vector<Meshlet>& rAMeshlet);
+	// after GeometryPool::Upload()
+	void Upload(const GeometryPool& rPool);
+
+	// overwrites results of slot rView.m_idxCull, EARLY and LATE use different slots, LATE needs Hi-Z of depth drawn by EARLY
+	void Cull(const View& rView, CullPhase phase, const HiZ* pHiZ) const;
+
+	GLU GetVAO(Bool positionOnly) const { return positionOnly ? m_VAOPosition : m_VAO; }
+	// with VAO from GetVAO() bound
+	void DrawIndirect(U32 idxView, U32 idxMesh) const {
+		g_stateCache.BindDrawIndirectBuffer(m_bufCommand);
+		glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(GetIdxCommand(idxView, idxMesh) * sizeof(DrawElementsIndirectCommand)));
+	}
+
+	// command of mesh in view, for passes which read back what indirect draws drew
+	U32 GetIdxCommand(U32 idxView, U32 idxMesh) const { return idxView * U32(m_aCommandTemplate.size()) + idxMesh; }
+	// DrawElementsIndirectCommand per command, firstIndex into 32 bit culled index buffer
+	GLU GetCommandBuffer() const { return m_bufCommand; }
+	GLU GetIndexCulledBuffer() const { return m_bufIndexCulled; }
+
+private:
+	struct DrawElementsIndirectCommand {
+		U32 m_count;
+		U32 m_instanceCount;
+		U32 m_firstIndex;
+		I32 m_baseVertex;
+		U32 m_baseInstance;
+	};
+
+	Shader m_passCull;
+	std::vector<Meshlet> m_aMeshlet;
+	std::vector<DrawElementsIndirectCommand> m_aCommandTemplate; // per mesh, count 0, firstIndex inside region of view 0
+	U32 m_numIndicesLod0 = 0;	// size of region of one view in culled index buffer
+	Bool m_index16 = false;		// type of shared index buffer
+
+	GLU m_bufIndex = 0;			// shared, read
+	GLU m_bufMeshlet = 0;
+	GLU m_bufVisibility = 0;	// per meshlet, result of last LATE
+	GLU m_bufIndexCulled = 0;	// 32 bit, region per view
+	GLU m_bufCommandReset = 0;	// m_aCommandTemplate for all views
+	GLU m_bufCommand = 0;
+	GLU m_VAO = 0;
+	GLU m_VAOPosition = 0;
+};
\ No newline at end of file
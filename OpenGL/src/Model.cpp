@@ -1,91 +1,84 @@
 #include "Model.h"
+#include "MeshOptimizer.h"
+#include "JobSystem.h"			// g_jobSystem
+#include "Profiler.h"			// ProfileScope
 
 #include <glad/glad.h>			// OGL stuff
 
 #include <assimp/Importer.hpp>	// assimp::Importer
 #include <assimp/postprocess.h>	// assimp flags
 
-//file loader
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_WINDOWS_UTF8		// WideCharToMultiByte
-#include <stb_image.h>			// stbi_load(), stbi_convert_wchar_to_utf8()
+#include <algorithm>			// std::find
+#include <array>				// std::array
 #include <unordered_map>		// std::unordered_map
 #include <iostream>				// std::cout
+#include <limits>				// std::numeric_limits
+#include <iomanip>				// std::setprecision
 
 using Path = std::filesystem::path;
 
+// textures are ids in TextureStreamer
 struct OpaqueMaterial {
-	GLU m_diffuse = 0;
-	GLU m_specular = 0;
-	GLU m_normal = 0;
+	U32 m_diffuse = 0;
+	U32 m_specular = 0;
+	U32 m_normal = 0;
+	U32 m_idxFeedback = 0;
 	explicit OpaqueMaterial() = default;
-	explicit OpaqueMaterial(GLU d, GLU s, GLU n) : m_diffuse(d), m_specular(s), m_normal(n) {}
+	explicit OpaqueMaterial(U32 d, U32 s, U32 n, U32 idxFeedback) : m_diffuse(d), m_specular(s), m_normal(n), m_idxFeedback(idxFeedback) {}
 };
 
 struct AlphaMaskedMaterial : OpaqueMaterial {
-	GLU m_mask = 0;
+	U32 m_mask = 0;
 	explicit AlphaMaskedMaterial() = default;
-	explicit AlphaMaskedMaterial(GLU d, GLU s, GLU n, GLU m) : OpaqueMaterial(d, s, n), m_mask(m) {}
+	explicit AlphaMaskedMaterial(U32 d, U32 s, U32 n, U32 m, U32 idxFeedback) : OpaqueMaterial(d, s, n, idxFeedback), m_mask(m) {}
 };
 
-Model::Model(std::string pathModel) {
-	// load model
-	Assimp::Importer importer;
-	const std::string kPathFolderWithModels = "models/";
-	pathModel.insert(0, kPathFolderWithModels);
-	const aiScene* pScene = importer.ReadFile(pathModel, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-
-	if (!pScene || pScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !pScene->mRootNode) {
-		std::cout << "Failed to load model: " << pathModel << "\nERROR::ASSIMP::" << importer.GetErrorString() << "\n";
-		return;
+Quantization CalculateQuantization(const aiScene& rScene) {
+	Vec3 posMin(std::numeric_limits<F32>::max());
+	Vec3 posMax(std::numeric_limits<F32>::lowest());
+	F32 rangeUv = 1;
+	for (unsigned i = 0; i < rScene.mNumMeshes; i++) {
+		const aiMesh& rMesh = *(rScene.mMeshes[i]);
+		Vec2 uvMin(std::numeric_limits<F32>::max());
+		Vec2 uvMax(std::numeric_limits<F32>::lowest());
+		for (unsigned j = 0; j < rMesh.mNumVertices; j++) {
+			const Vec3 position(rMesh.mVertices[j].x, rMesh.mVertices[j].y, rMesh.mVertices[j].z);
+			posMin = glm::min(posMin, position);
+			posMax = glm::max(posMax, position);
+			if (rMesh.HasTextureCoords(0)) {
+				const Vec2 uv(rMesh.mTextureCoords[0][j].x, rMesh.mTextureCoords[0][j].y);
+				uvMin = glm::min(uvMin, uv);
+				uvMax = glm::max(uvMax, uv);
+			}
+		}
+		// same rebasing as in PackVertices()
+		if (rMesh.HasTextureCoords(0) && rMesh.mNumVertices > 0) {
+			const Vec2 uvExtent = uvMax - glm::floor(uvMin);
+			rangeUv = std::max(rangeUv, std::ceil(std::max(uvExtent.x, uvExtent.y)));
+		}
 	}
-	
-	std::unordered_map<U32, OpaqueMaterial> opaqueMaterials;
-	std::unordered_map<U32, AlphaMaskedMaterial> transparentMaterials;
-
-	Path directory(pathModel);
-	directory.remove_filename();
-
-	GLU dummyDiffuse  = TextureFromFile(kPathFolderWithModels, "dummy.tga");
-	GLU dummySpecular = TextureFromFile(kPathFolderWithModels, "dummy_specular.tga");
-	GLU dummyNormal   = TextureFromFile(kPathFolderWithModels, "dummy_ddn.tga");
-
-	for (unsigned i = 0; i < pScene->mNumMaterials; i++) {
-		const aiMaterial& rMaterial = *(pScene->mMaterials[i]);
-		auto GetTexture = [&rMaterial, &directory](const aiTextureType type) {
-			if (rMaterial.GetTextureCount(type) == 0)
-				return GLU(0);
-			aiString name;
-			rMaterial.GetTexture(type, 0, &name);
-			return TextureFromFile(directory, name.C_Str());
-		};
 
-		GLU diffuse  = GetTexture(aiTextureType_DIFFUSE);
-		GLU specular = GetTexture(aiTextureType_SPECULAR);
-		GLU normal   = GetTexture(aiTextureType_NORMALS);
-		if (diffuse == 0)
-			diffuse  = dummyDiffuse;
-		if (specular == 0)
-			specular = dummySpecular;
-		if (normal == 0)
-			normal   = dummyNormal;
+	Quantization quantization;
+	quantization.m_posMin = posMin;
+	quantization.m_posExtent = glm::max(posMax - posMin, Vec3(1e-6f));
+	quantization.m_rangeUv = rangeUv;
+	return quantization;
+}
 
-		if (rMaterial.GetTextureCount(aiTextureType_OPACITY) > 0) {
-			// This sponza model has broken OPACITY textures (sometimes it gives specular map, sometimes diffuse
-			// but only diffuse seeems to be correct when retrieving alpha channel),
-			// so when you switch to not broken model, uncomment code commented below and delete the rest
+namespace {
+	struct ProcessedMesh {
+		std::vector<Vertex>		m_aVertex;
+		std::vector<U32>		m_aIndexAllLods;
+		std::vector<MeshLod>	m_aLod;
+		std::vector<Meshlet>	m_aMeshlet;
+		VertexCacheStats		m_statsBefore;
+		VertexCacheStats		m_statsAfter;
+	};
 
-			// GLU mask = GetTexture(aiTextureType_OPACITY);
-			// assert(mask != 0);
-			// transparentMaterials[i] = AlphaMaskedMaterial(diffuse, specular, normal, mask);
-			transparentMaterials[i] = AlphaMaskedMaterial(diffuse, specular, normal, diffuse); // notice diffuse passed in place of mask
-		} else {
-			opaqueMaterials[i] = OpaqueMaterial(diffuse, specular, normal);
-		}
-	}
-
-	for (unsigned i = 0; i < pScene->mNumMeshes; i++) {
-		const aiMesh& rMesh = *(pScene->mMeshes[i]);
+	// CPU only, so it can run in job
+	ProcessedMesh ProcessMesh(const aiMesh& rMesh) {
+		// LOD error can't exceed this fraction of mesh extent
+		const F32 kMaxErrorLodRelative = 0.05f;
 
 		std::vector<Vertex>	aVertex;
 		std::vector<U32>	aIndex;
@@ -113,19 +106,18 @@ Model::Model(std::string pathModel) {
 			const Vec3 N(rMesh.mNormals[j].x,
 						 rMesh.mNormals[j].y,
 						 rMesh.mNormals[j].z);
-			Vec3 T	    (rMesh.mTangents[j].x,
+			const Vec3 T(rMesh.mTangents[j].x,
 						 rMesh.mTangents[j].y,
 						 rMesh.mTangents[j].z);
 			const Vec3 B(rMesh.mBitangents[j].x,
 						 rMesh.mBitangents[j].y,
 						 rMesh.mBitangents[j].z);
 
-			// on symetric models T sometimes gets messy, fix it
-			if (glm::dot(glm::cross(N, T), B) > 0)
-				T *= -1.f;
+			// on symetric models T sometimes gets messy (mirrored UVs), fix it on GPU by flipping T
+			const F32 sign = glm::dot(glm::cross(N, T), B) > 0 ? -1.f : 1.f;
 
 			vertex.m_normal = N;
-			vertex.m_tangent = T;
+			vertex.m_tangent = Vec4(T, sign);
 			// on GPU we calculate bitangent with cross(N,T), hence, we dont need to save it
 			aVertex.push_back(vertex);
 		} // for (U32 j = 0; j < mesh->mNumVertices; j++)
@@ -137,60 +129,218 @@ Model::Model(std::string pathModel) {
 				aIndex.push_back(face.mIndices[k]);
 			}
 		}
+
+		// optimize and build LODs, all of them share vertices and index buffer
+		ProcessedMesh processed;
+		processed.m_statsBefore = AnalyzeVertexCache(aIndex, aVertex.size());
+		std::vector<U32>& rAIndexAllLods = processed.m_aIndexAllLods;
+		std::vector<MeshLod>& rALod = processed.m_aLod;
+		F32 errorLod = 0;
+		while (rALod.size() < Mesh::kMaxLods) {
+			if (!rALod.empty()) {
+				// stop when simplification is stuck on seams/borders or error, LOD wouldn't pay for itself
+				F32 error;
+				std::vector<U32> aIndexSimplified = SimplifyMesh(aVertex, aIndex, aIndex.size() / 2, kMaxErrorLodRelative, error);
+				if (aIndexSimplified.size() > aIndex.size() * 3 / 4)
+					break;
+				aIndex.swap(aIndexSimplified);
+				// each LOD is simplified from previous one, sum of steps bounds distance from LOD 0
+				errorLod += error;
+			}
+			const std::vector<U32> aHardBoundary = OptimizeVertexCache(aIndex, aVertex.size());
+			OptimizeOverdraw(aIndex, aVertex, aHardBoundary);
+			rALod.push_back({ U32(rAIndexAllLods.size()), U32(aIndex.size()), errorLod });
+			rAIndexAllLods.insert(rAIndexAllLods.end(), aIndex.begin(), aIndex.end());
+		}
+		OptimizeVertexFetch(aVertex, rAIndexAllLods);
+
+		const std::vector<U32> aIndexLod0(rAIndexAllLods.begin(), rAIndexAllLods.begin() + rALod[0].m_numIndices);
+		processed.m_aMeshlet = BuildMeshlets(aVertex, aIndexLod0);
+		processed.m_statsAfter = AnalyzeVertexCache(aIndexLod0, aVertex.size());
+		processed.m_aVertex.swap(aVertex);
+		return processed;
+	}
+}
+
+Model::Model(std::string pathModel, UploadManager& rUploadManager, Size budgetTextures)
+	: m_textures(rUploadManager, budgetTextures)
+{
+	// load model
+	Assimp::Importer importer;
+	const std::string kPathFolderWithModels = "models/";
+	pathModel.insert(0, kPathFolderWithModels);
+	const aiScene* pScene;
+	{
+		ProfileScope profile("load: import");
+		pScene = importer.ReadFile(pathModel, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	}
+
+	if (!pScene || pScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !pScene->mRootNode) {
+		std::cout << "Failed to load model: " << pathModel << "\nERROR::ASSIMP::" << importer.GetErrorString() << "\n";
+		return;
+	}
+	
+	std::unordered_map<U32, OpaqueMaterial> opaqueMaterials;
+	std::unordered_map<U32, AlphaMaskedMaterial> transparentMaterials;
+
+	Path directory(pathModel);
+	directory.remove_filename();
+
+	// materials share textures, so each file is loaded once
+	std::vector<Path> aPathTexture;
+	std::vector<TextureStreamer::Role> aRoleTexture;	// of first material using it
+	std::unordered_map<std::string, U32> idxTextureOfPath;
+	auto AddTexture = [&](const Path& rDirectory, const char* pathRelativeFile, TextureStreamer::Role role) {
+		Path path(rDirectory);
+		path.concat(pathRelativeFile);
+		const auto itInserted = idxTextureOfPath.emplace(path.string(), U32(aPathTexture.size()));
+		if (itInserted.second) {
+			aPathTexture.push_back(path);
+			aRoleTexture.push_back(role);
+		}
+		return itInserted.first->second;
+	};
+
+	const U32 idxDummyDiffuse  = AddTexture(kPathFolderWithModels, "dummy.tga", TextureStreamer::Role::DIFFUSE);
+	const U32 idxDummySpecular = AddTexture(kPathFolderWithModels, "dummy_specular.tga", TextureStreamer::Role::SPECULAR);
+	const U32 idxDummyNormal   = AddTexture(kPathFolderWithModels, "dummy_ddn.tga", TextureStreamer::Role::NORMAL);
+
+	// diffuse, specular, normal
+	std::vector<std::array<U32, 3>> aIdxTextureOfMaterial(pScene->mNumMaterials);
+	for (unsigned i = 0; i < pScene->mNumMaterials; i++) {
+		const aiMaterial& rMaterial = *(pScene->mMaterials[i]);
+		auto GetTexture = [&rMaterial, &directory, &AddTexture](const aiTextureType type, TextureStreamer::Role role, U32 idxDummy) {
+			if (rMaterial.GetTextureCount(type) == 0)
+				return idxDummy;
+			aiString name;
+			rMaterial.GetTexture(type, 0, &name);
+			return AddTexture(directory, name.C_Str(), role);
+		};
+		aIdxTextureOfMaterial[i] = { GetTexture(aiTextureType_DIFFUSE,  TextureStreamer::Role::DIFFUSE,  idxDummyDiffuse),
+									 GetTexture(aiTextureType_SPECULAR, TextureStreamer::Role::SPECULAR, idxDummySpecular),
+									 GetTexture(aiTextureType_NORMALS,  TextureStreamer::Role::NORMAL,   idxDummyNormal) };
+	}
+
+	m_quantization = CalculateQuantization(*pScene);
+
+	// only headers of textures are read now, their levels stream in as geometry pass asks for them (see TextureStreamer),
+	// mesh processing runs on all cores, GL objects are created below in original order
+	struct ImageHeader {
+		int m_width = 1;
+		int m_height = 1;
+		int m_numChannels = 0;
+	};
+	std::vector<ImageHeader> aHeader(aPathTexture.size());
+	std::vector<ProcessedMesh> aProcessedMesh(pScene->mNumMeshes);
+	{
+		JobSystem::Counter counter{ 0 };
+		for (Size i = 0; i < aPathTexture.size(); i++)
+			g_jobSystem.Run("load: read texture header", [&aHeader, &aPathTexture, i] {
+				ImageHeader& rHeader = aHeader[i];
+				if (!TextureStreamer::ReadHeader(aPathTexture[i], rHeader.m_width, rHeader.m_height, rHeader.m_numChannels))
+					rHeader = ImageHeader();
+			}, counter);
+		for (unsigned i = 0; i < pScene->mNumMeshes; i++)
+			g_jobSystem.Run("load: process mesh", [&aProcessedMesh, pScene, i] { aProcessedMesh[i] = ProcessMesh(*(pScene->mMeshes[i])); }, counter);
+		g_jobSystem.Wait(counter);
+	}
+
+	// textures which failed to load keep placeholder of their role
+	std::vector<U32> aIdTexture(aPathTexture.size());
+	for (Size i = 0; i < aPathTexture.size(); i++)
+		aIdTexture[i] = m_textures.Add(aPathTexture[i], aHeader[i].m_width, aHeader[i].m_height, aHeader[i].m_numChannels, aRoleTexture[i]);
+
+	for (unsigned i = 0; i < pScene->mNumMaterials; i++) {
+		const aiMaterial& rMaterial = *(pScene->mMaterials[i]);
+		const U32 diffuse  = aIdTexture[aIdxTextureOfMaterial[i][0]];
+		const U32 specular = aIdTexture[aIdxTextureOfMaterial[i][1]];
+		const U32 normal   = aIdTexture[aIdxTextureOfMaterial[i][2]];
+		const U32 idxFeedback = m_textures.AddFeedbackSlot({ diffuse, specular, normal });
+
+		if (rMaterial.GetTextureCount(aiTextureType_OPACITY) > 0) {
+			// This sponza model has broken OPACITY textures (sometimes it gives specular map, sometimes diffuse
+			// but only diffuse seeems to be correct when retrieving alpha channel),
+			// so when you switch to not broken model, uncomment code commented below and delete the rest
+
+			// U32 mask = GetTexture(aiTextureType_OPACITY);
+			// transparentMaterials[i] = AlphaMaskedMaterial(diffuse, specular, normal, mask, idxFeedback);
+			transparentMaterials[i] = AlphaMaskedMaterial(diffuse, specular, normal, diffuse, idxFeedback); // notice diffuse passed in place of mask
+		} else {
+			opaqueMaterials[i] = OpaqueMaterial(diffuse, specular, normal, idxFeedback);
+		}
+	}
+
+	// opaque meshes at least this fraction of model extent (walls, floors, columns) occlude on CPU
+	const F32 kMinExtentOccluderRelative = 0.1f;
+	F64 missesBefore = 0;
+	F64 missesAfter = 0;
+	Size numTriangles = 0;
+	Size numTrianglesOccluder = 0;
+
+	for (unsigned i = 0; i < pScene->mNumMeshes; i++) {
+		const aiMesh& rMesh = *(pScene->mMeshes[i]);
+		const ProcessedMesh& rProcessed = aProcessedMesh[i];
+		const std::vector<Vertex>& rAVertex = rProcessed.m_aVertex;
+		const std::vector<U32>& rAIndexAllLods = rProcessed.m_aIndexAllLods;
+		const std::vector<MeshLod>& rALod = rProcessed.m_aLod;
+		const std::vector<Meshlet>& rAMeshlet = rProcessed.m_aMeshlet;
+		const VertexCacheStats& rStatsBefore = rProcessed.m_statsBefore;
+		const VertexCacheStats& rStatsAfter = rProcessed.m_statsAfter;
+
+		std::cout << std::fixed << std::setprecision(3)
+				  << "Mesh " << i << " (" << rMesh.mName.C_Str() << ", triangles per LOD:";
+		for (const MeshLod& rLod : rALod)
+			std::cout << " " << rLod.m_numIndices / 3;
+		std::cout << "): "
+				  << "ACMR " << rStatsBefore.m_acmr << " -> " << rStatsAfter.m_acmr << ", "
+				  << "ATVR " << rStatsBefore.m_atvr << " -> " << rStatsAfter.m_atvr << "\n"
+				  << std::defaultfloat;
+		missesBefore += rStatsBefore.m_atvr * rMesh.mNumVertices;
+		missesAfter += rStatsAfter.m_atvr * rAVertex.size();
+		numTriangles += rALod[0].m_numIndices / 3;
+
 		// process material
 		const unsigned idxMat = rMesh.mMaterialIndex;
 		const auto itTransparent = transparentMaterials.find(idxMat);
 		if (itTransparent != transparentMaterials.end()) {
 			AlphaMaskedMaterial m = itTransparent->second;
-			m_transparentMeshes.emplace_back(aVertex, aIndex, m.m_diffuse, m.m_specular, m.m_normal, m.m_mask);
+			if (std::find(m_aIdMask.begin(), m_aIdMask.end(), m.m_mask) == m_aIdMask.end())
+				m_aIdMask.push_back(m.m_mask);
+			m_transparentMeshes.emplace_back(m_pool, m_culler, m_occlusionCuller, rAVertex, rAIndexAllLods, rALod, rAMeshlet, m_quantization,
+											 m_textures, m.m_idxFeedback, m.m_diffuse, m.m_specular, m.m_normal, m.m_mask);
 		} else {
 			const auto itOpaque = opaqueMaterials.find(idxMat);
 			assert(itOpaque != opaqueMaterials.end());
 			const OpaqueMaterial m = itOpaque->second;
-			m_opaqueMeshes.emplace_back(aVertex, aIndex, m.m_diffuse, m.m_specular, m.m_normal);
+			m_opaqueMeshes.emplace_back(m_pool, m_culler, m_occlusionCuller, rAVertex, rAIndexAllLods, rALod, rAMeshlet, m_quantization,
+										m_textures, m.m_idxFeedback, m.m_diffuse, m.m_specular, m.m_normal);
+
+			// LOD 0 is occluder, simplified LODs bulge outwards as well as inwards and would hide visible meshes
+			std::vector<Vec3> aPosition;
+			Vec3 posMin(std::numeric_limits<F32>::max());
+			Vec3 posMax(std::numeric_limits<F32>::lowest());
+			for (const Vertex& rVertex : rAVertex) {
+				aPosition.push_back(rVertex.m_position);
+				posMin = glm::min(posMin, rVertex.m_position);
+				posMax = glm::max(posMax, rVertex.m_position);
+			}
+			if (glm::length(posMax - posMin) >= kMinExtentOccluderRelative * glm::length(m_quantization.m_posExtent)) {
+				const MeshLod& rLod = rALod[0];
+				const std::vector<U32> aIndexOccluder(rAIndexAllLods.begin() + rLod.m_firstIndex, rAIndexAllLods.begin() + rLod.m_firstIndex + rLod.m_numIndices);
+				m_occlusionCuller.AddOccluder(aPosition, aIndexOccluder);
+				numTrianglesOccluder += aIndexOccluder.size() / 3;
+			}
 		}
 	}
-}
+	if (numTriangles > 0)
+		std::cout << "Model " << pathModel << ": ACMR " << missesBefore / numTriangles << " -> " << missesAfter / numTriangles << "\n";
+	std::cout << "Model " << pathModel << ": " << numTrianglesOccluder << " occluder triangles\n";
 
-GLU TextureFromFile(const Path& directory, const char* pathRelativeFile, bool generateMipMap) {
-	Path path(directory);
-	path.concat(pathRelativeFile);
-	char buffer[1024];
-	stbi_convert_wchar_to_utf8(&buffer[0], 1024, path.c_str());
-	int width;
-	int height;
-	int numberOfChannels;
-	stbi_uc* data = stbi_load(&buffer[0], &width, &height, &numberOfChannels, 0);
-	if (data != nullptr) {
-		GLE format;
-		GLE	internalFormat;
-		if (numberOfChannels == 1) {
-			format = GL_RED;
-			internalFormat = GL_R8;
-		} else if (numberOfChannels == 3) {
-			format = GL_RGB;
-			internalFormat = GL_RGB8;
-		} else if (numberOfChannels == 4) {
-			format = GL_RGBA; 
-			internalFormat = GL_RGBA8;
-		} else {
-			std::cout << "WARNING! Wrong number of channels for: " << path << "\n";
-		}
+	for (U32 i = 0; i < m_opaqueMeshes.size(); i++)
+		m_aIdxLoadedOpaque.push_back(i);
+	for (U32 i = 0; i < m_transparentMeshes.size(); i++)
+		m_aIdxLoadedMasked.push_back(i);
 
-		GLU textureID;
-		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
-		GLS levels = 1;
-		if (generateMipMap)
-			levels = log2f(std::max(width, height)) + 1;
-		glTextureStorage2D(textureID, levels, internalFormat, width, height);
-		glTextureSubImage2D(textureID, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
-		if (generateMipMap)
-			glGenerateTextureMipmap(textureID);
-
-		stbi_image_free(data);
-		return textureID;
-	} else {
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		return 0;
-	}
+	m_pool.Upload(rUploadManager);
+	m_culler.Upload(m_pool);
 }
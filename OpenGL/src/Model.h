@@ -4,42 +4,118 @@
 
 #include "types.h"
 #include "Mesh.h"			// Mesh
+#include "GeometryPool.h"	// GeometryPool
+#include "MeshletCuller.h"	// MeshletCuller
+#include "MaskedOcclusionCuller.h"	// MaskedOcclusionCuller
+#include "UploadManager.h"	// UploadManager
+#include "TextureStreamer.h"	// TextureStreamer
+#include "DrawOrder.h"		// DrawOrder
 
 #include <vector>			// std::vector
-#include <filesystem>		// std::filesystem::path
-
-using Path = std::filesystem::path;
 
 class Model
 {
 public:
-	Model(std::string path);
+	// geometry is uploaded right away, textures start as placeholders and stream in through rUploadManager,
+	// which has to outlive model, budgetTextures in bytes
+	Model(std::string path, UploadManager& rUploadManager, Size budgetTextures);
+	// meshes point to m_pool, m_culler and m_textures
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
+	// geometry pass writes its feedback, call Update() once per frame
+	TextureStreamer& GetTextureStreamer() { return m_textures; }
 
 	// because I have only 1 model, I didn't bother with making renderer
 
-	void DrawGeometryOnly() const {
-		for (const Mesh& rMesh : m_opaqueMeshes)
-			rMesh.DrawGeometryOnly();
+	// fills results of rView.m_idxCull for Draw*() with the same view
+	void Cull(const View& rView, MeshletCuller::CullPhase phase = MeshletCuller::CullPhase::SINGLE, const HiZ* pHiZ = nullptr) const {
+		m_culler.Cull(rView, phase, pHiZ);
+	}
+
+	// rasterizes large occluders on CPU and makes Draw*() with rView skip occluded meshes
+	void CullOcclusionCpu(View& rView) {
+		m_occlusionCuller.Cull(rView.m_modelViewProj);
+		rView.m_pOcclusionCuller = &m_occlusionCuller;
+	}
+
+	// sorts meshes by policy for Draw*() with rView, which keeps pointer to rOrder
+	void SortDraws(View& rView, DrawOrder& rOrder, DrawOrder::Policy policy) const {
+		rOrder.Sort(rView, m_opaqueMeshes, m_transparentMeshes, policy);
+		rView.m_pDrawOrder = &rOrder;
+	}
+
+	void DrawPositionOnly(const View& rView) const {
+		for (U32 idx : GetOrderOpaque(rView))
+			m_opaqueMeshes[idx].DrawPositionOnly(rView);
+	}
+
+	void Draw(const View& rView) const {
+		for (U32 idx : GetOrderOpaque(rView))
+			m_opaqueMeshes[idx].Draw(rView);
+	}
+
+	void DrawWithMask(const View& rView) const {
+		for (U32 idx : GetOrderMasked(rView))
+			m_transparentMeshes[idx].DrawWithMask(rView);
+	}
+
+	void DrawWithMaskOnly(const View& rView) const {
+		for (U32 idx : GetOrderMasked(rView))
+			m_transparentMeshes[idx].DrawWithMaskOnly(rView);
 	}
 
-	void Draw() const {
-		for (const Mesh& rMesh : m_opaqueMeshes)
-			rMesh.Draw();
+	void DrawVisibility(const View& rView, VisibilityBuffer& rVisibility) const {
+		for (U32 idx : GetOrderOpaque(rView))
+			m_opaqueMeshes[idx].DrawVisibility(rView, rVisibility);
 	}
 
-	void DrawWithMask() const {
-		for (const Mesh& rMesh : m_transparentMeshes)
-			rMesh.DrawWithMask();
+	void DrawVisibilityWithMask(const View& rView, VisibilityBuffer& rVisibility) const {
+		for (U32 idx : GetOrderMasked(rView))
+			m_transparentMeshes[idx].DrawVisibility(rView, rVisibility);
 	}
 
-	void DrawWithMaskOnly() const {
-		for (const Mesh& rMesh : m_transparentMeshes)
-			rMesh.DrawWithMaskOnly();
+	// materials are feedback slots of texture streamer, textures go to units of geometry pass (1 - 3)
+	U32 GetNumMaterials() const { return m_textures.GetNumFeedbackSlots(); }
+	void BindMaterialTextures(U32 idxMaterial) const {
+		const std::vector<U32>& rAIdTexture = m_textures.GetTexturesOfSlot(idxMaterial); // diffuse, specular, normal
+		for (U32 i = 0; i < rAIdTexture.size(); i++)
+			g_stateCache.BindTextureUnit(1 + i, m_textures.GetTexture(rAIdTexture[i]));
+	}
+
+	// for passes which fetch geometry themselves
+	const GeometryPool& GetGeometryPool() const { return m_pool; }
+	const MeshletCuller& GetMeshletCuller() const { return m_culler; }
+
+	// vertex positions are unorm relative to model bounds, so this goes right after model matrix
+	Mat4 GetMatDequantize() const { return m_quantization.GetMatDequantize(); }
+	F32 GetRangeUv() const { return m_quantization.m_rangeUv; }
+
+	// changes whenever resident levels of alpha masks change, so does what DrawWithMaskOnly() rasterizes
+	U64 GetGenerationMasks() const {
+		U64 generation = 0;
+		for (U32 idTexture : m_aIdMask)
+			generation += m_textures.GetGeneration(idTexture);
+		return generation;
 	}
 
 private:
+	// indices of meshes in order of rView.m_pDrawOrder, in order of loading without it
+	const std::vector<U32>& GetOrderOpaque(const View& rView) const {
+		return rView.m_pDrawOrder != nullptr ? rView.m_pDrawOrder->GetOpaque() : m_aIdxLoadedOpaque;
+	}
+	const std::vector<U32>& GetOrderMasked(const View& rView) const {
+		return rView.m_pDrawOrder != nullptr ? rView.m_pDrawOrder->GetMasked() : m_aIdxLoadedMasked;
+	}
+
+	Quantization m_quantization;
+	GeometryPool m_pool;
+	MeshletCuller m_culler;
+	MaskedOcclusionCuller m_occlusionCuller;
 	std::vector<Mesh> m_opaqueMeshes;
 	std::vector<Mesh> m_transparentMeshes;
-};
-
-GLU TextureFromFile(const Path& directory, const char* pathRelativeFile, bool generateMipMap = true);
\ No newline at end of file
+	std::vector<U32> m_aIdxLoadedOpaque;	// 0, 1, 2, ...
+	std::vector<U32> m_aIdxLoadedMasked;
+	TextureStreamer m_textures;
+	std::vector<U32> m_aIdMask;	// textures of m_textures, each once
+};
\ No newline at end of file
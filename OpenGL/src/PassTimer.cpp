@@ -0,0 +1,62 @@
+#include "PassTimer.h"
+
+#include <iomanip>		// std::setprecision
+#include <iostream>		// std::cout
+
+PassTimer::PassTimer(U32 numPasses)
+	: m_numPasses(numPasses), m_aStats(numPasses)
+{
+	for (U32 i = 0; i < kNumFramesQuery; i++) {
+		m_aAQueryTime[i].resize(numPasses);
+		m_aAIssued[i].resize(numPasses, false);
+		glCreateQueries(GL_TIME_ELAPSED, GLS(numPasses), m_aAQueryTime[i].data());
+	}
+}
+
+PassTimer::~PassTimer() {
+	for (U32 i = 0; i < kNumFramesQuery; i++)
+		glDeleteQueries(GLS(m_numPasses), m_aAQueryTime[i].data());
+}
+
+void PassTimer::BeginPass(U32 idxPass) {
+	glBeginQuery(GL_TIME_ELAPSED, m_aAQueryTime[m_idxFrame][idxPass]);
+}
+
+void PassTimer::EndPass(U32 idxPass) {
+	glEndQuery(GL_TIME_ELAPSED);
+	m_aAIssued[m_idxFrame][idxPass] = true;
+}
+
+void PassTimer::EndFrame(const std::function<Size(U32 idxPass)>& rGetBytes) {
+	m_idxFrame = (m_idxFrame + 1) % kNumFramesQuery;
+
+	// oldest queries are kNumFramesQuery frames old
+	std::vector<Bool>& rAIssued = m_aAIssued[m_idxFrame];
+	for (U32 i = 0; i < m_numPasses; i++) {
+		if (!rAIssued[i])
+			continue;
+		rAIssued[i] = false;
+		GLI available = 0;
+		glGetQueryObjectiv(m_aAQueryTime[m_idxFrame][i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+			continue;
+		U64 nsGpu = 0;
+		glGetQueryObjectui64v(m_aAQueryTime[m_idxFrame][i], GL_QUERY_RESULT, &nsGpu);
+		m_aStats[i].m_msGpu = F64(nsGpu) / 1e6;
+		m_aStats[i].m_bytes = rGetBytes(i);
+	}
+}
+
+void PassTimer::PrintStats(const std::function<const Char*(U32 idxPass)>& rGetName) const {
+	std::cout << std::fixed << std::setprecision(2);
+	for (U32 i = 0; i < m_numPasses; i++) {
+		const Stats& rStats = m_aStats[i];
+		// bytes over time of whole pass, so lower bound of bandwidth pass actually uses
+		const F64 gbPerSecond = rStats.m_msGpu > 0 ? F64(rStats.m_bytes) / (rStats.m_msGpu * 1e6) : 0;
+		std::cout << "  " << std::left << std::setw(24) << rGetName(i) << std::right
+				  << std::setw(8) << F64(rStats.m_bytes) / (1 << 20) << " MB "
+				  << std::setw(8) << rStats.m_msGpu << " ms "
+				  << std::setw(8) << gbPerSecond << " GB/s\n";
+	}
+	std::cout << std::defaultfloat;
+}
\ No newline at end of file
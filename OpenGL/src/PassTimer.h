@@ -0,0 +1,45 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+
+#include <array>		// std::array
+#include <functional>	// std::function
+#include <vector>		// std::vector
+
+// GPU time and traffic of passes, shared by GBuffer and GtaoBuffer: GL_TIME_ELAPSED query per pass in ring of
+// kNumFramesQuery frames, read back when ring comes around without waiting, together with bytes pass moved in that
+// frame, which owner computes (it depends on layout and other state of that frame, kept by owner per GetIdxFrame()).
+class PassTimer
+{
+public:
+	static constexpr U32 kNumFramesQuery = 3;
+
+	explicit PassTimer(U32 numPasses);
+	~PassTimer();
+	PassTimer(const PassTimer&) = delete;
+	PassTimer& operator=(const PassTimer&) = delete;
+
+	// around work of pass, passes can't overlap
+	void BeginPass(U32 idxPass);
+	void EndPass(U32 idxPass);
+	// frame of ring passes are issued in, after EndFrame() the oldest one whose results were read back
+	U32 GetIdxFrame() const { return m_idxFrame; }
+	// moves to oldest frame of ring and reads back its queries, results which still aren't there are skipped instead of
+	// waited for, rGetBytes(idxPass) gives bytes pass moved in that frame
+	void EndFrame(const std::function<Size(U32 idxPass)>& rGetBytes);
+	// line per pass: bytes, GPU time and bandwidth of a few frames ago
+	void PrintStats(const std::function<const Char*(U32 idxPass)>& rGetName) const;
+
+private:
+	struct Stats {
+		F64 m_msGpu = 0;
+		Size m_bytes = 0;
+	};
+
+	U32 m_numPasses;
+	std::array<std::vector<GLU>, kNumFramesQuery> m_aAQueryTime;
+	std::array<std::vector<Bool>, kNumFramesQuery> m_aAIssued;
+	U32 m_idxFrame = 0;
+	std::vector<Stats> m_aStats;
+};
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include "Profiler.h"
+
+#include <algorithm>	// std::max
+#include <iomanip>		// std::setprecision
+#include <iostream>		// std::cout
+
+Profiler g_profiler;
+
+void Profiler::Record(const char* label, Clock::time_point begin, Clock::time_point end) {
+	const F64 ms = std::chrono::duration<F64, std::milli>(end - begin).count();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Stats& rStats = m_aStats[label];
+	rStats.m_count++;
+	rStats.m_msTotal += ms;
+	rStats.m_msMax = std::max(rStats.m_msMax, ms);
+}
+
+void Profiler::EndFrame() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_aStatsLastFrame.swap(m_aStats);
+	m_aStats.clear();
+}
+
+void Profiler::PrintStats() const {
+	std::cout << std::fixed << std::setprecision(3) << "CPU timings (count, total ms, longest ms):\n";
+	for (const auto& rLabelStats : m_aStatsLastFrame) {
+		const Stats& rStats = rLabelStats.second;
+		std::cout << "\t" << rLabelStats.first << ": " << rStats.m_count << ", " << rStats.m_msTotal << ", " << rStats.m_msMax << "\n";
+	}
+	std::cout << std::defaultfloat;
+}
\ No newline at end of file
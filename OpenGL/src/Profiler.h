@@ -0,0 +1,55 @@
+#pragma once
+#include "types.h"
+
+#include <chrono>		// std::chrono::steady_clock
+#include <cstring>		// std::strcmp
+#include <map>			// std::map
+#include <mutex>		// std::mutex
+
+// CPU timings of labeled scopes and jobs, aggregated per frame (count, sum and longest one),
+// so work spread over job system threads shows up next to work of main thread.
+// Labels are compared by content, but are kept as pointers, so pass string literals.
+class Profiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// thread safe
+	void Record(const char* label, Clock::time_point begin, Clock::time_point end);
+
+	// latch timings of finished frame and start collecting from scratch
+	void EndFrame();
+	// prints timings of last finished frame
+	void PrintStats() const;
+
+private:
+	struct Stats {
+		U32 m_count = 0;
+		F64 m_msTotal = 0;
+		F64 m_msMax = 0;
+	};
+
+	struct CompareLabel {
+		Bool operator()(const char* a, const char* b) const { return std::strcmp(a, b) < 0; }
+	};
+
+	std::mutex m_mutex;
+	std::map<const char*, Stats, CompareLabel> m_aStats;
+	std::map<const char*, Stats, CompareLabel> m_aStatsLastFrame;
+};
+
+extern Profiler g_profiler;
+
+// records lifetime of scope
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* label) : m_label(label), m_begin(Profiler::Clock::now()) {}
+	~ProfileScope() { g_profiler.Record(m_label, m_begin, Profiler::Clock::now()); }
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* m_label;
+	Profiler::Clock::time_point m_begin;
+};
\ No newline at end of file
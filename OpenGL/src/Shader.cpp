@@ -137,8 +137,21 @@ Shader::Shader(std::string fileNameVs, std::string fileNameFs, std::string fileN
 }
 
 Shader::Shader(std::string fileNameCs) {
-	m_prettyName = "(" + fileNameCs + ")";
-	const GLI shaderNameCompute = CreateCompileShader(fileNameCs, GL_COMPUTE_SHADER, "", m_prettyName);
+	CreateCompute(fileNameCs, "");
+}
+
+Shader Shader::Compute(const std::string& rFileNameCs, const std::string& rDefines) {
+	Shader shader;
+	shader.CreateCompute(rFileNameCs, rDefines);
+	return shader;
+}
+
+void Shader::CreateCompute(const std::string& rFileNameCs, const std::string& rDefines) {
+	m_prettyName = "(" + rFileNameCs;
+	if (!rDefines.empty())
+		m_prettyName += ", defines: " + rDefines;
+	m_prettyName += ")";
+	const GLI shaderNameCompute = CreateCompileShader(rFileNameCs, GL_COMPUTE_SHADER, rDefines, m_prettyName);
 
 	m_id = glCreateProgram();
 	glAttachShader(m_id, shaderNameCompute);
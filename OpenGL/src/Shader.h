@@ -1,5 +1,6 @@
 #pragma once
 #include "types.h"
+#include "StateCache.h"	// g_stateCache
 
 #include <string>	// std::string
 #include <unordered_set>
@@ -11,9 +12,11 @@ public:
 	Shader(std::string fileNameVs, std::string fileNameFs, std::string fileNameGs = "", const std::string& rDefines = "");
 	// compute
 	Shader(std::string fileNameCs);
+	// compute with defines, variants of one kernel (constructor with two strings is graphic one)
+	static Shader Compute(const std::string& rFileNameCs, const std::string& rDefines);
 	
 	void Use() const {
-		glUseProgram(m_id);
+		g_stateCache.UseProgram(m_id);
 	}
 
 	// utility uniform functions
@@ -86,6 +89,9 @@ public:
 	}
 
 private:
+	Shader() = default;
+	void CreateCompute(const std::string& rFileNameCs, const std::string& rDefines);
+
 	GLI GetUniformLocation(const std::string& name) const {
 		return glGetUniformLocation(m_id, name.c_str());
 	}
@@ -0,0 +1,190 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>	// std::max_element, std::stable_sort
+#include <cassert>		// assert
+#include <cmath>		// sqrtf
+#include <numeric>		// std::iota
+
+namespace {
+	constexpr U32 kSizeGroup = 8;	// work group of shadowCoverage.comp in x and y
+}
+
+ShadowAtlas::ShadowAtlas(U32 numCascades)
+	: m_passCoverage("shadowCoverage.comp"), m_numCascades(numCascades)
+{
+	static_assert(ShadowAtlas::kSizeRectMax >> (ShadowAtlas::kNumLevels - 1) == ShadowAtlas::kSizeRectMin, "levels of allocator");
+	assert(numCascades <= kMaxCascades);
+	Reset();
+
+	glCreateBuffers(1, &m_bufCoverage);
+	glNamedBufferStorage(m_bufCoverage, kMaxCascades * sizeof(U32), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	// persistently mapped, so reading finished copies doesn't stall
+	for (U32 i = 0; i < kNumReadbacks; i++) {
+		const GLE flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &m_aBufReadback[i]);
+		glNamedBufferStorage(m_aBufReadback[i], kMaxCascades * sizeof(U32), nullptr, flags);
+		m_aMappedReadback[i] = (const U32*)glMapNamedBufferRange(m_aBufReadback[i], 0, kMaxCascades * sizeof(U32), flags);
+	}
+}
+
+ShadowAtlas::~ShadowAtlas() {
+	for (U32 i = 0; i < kNumReadbacks; i++) {
+		if (m_aFence[i] != nullptr)
+			glDeleteSync(m_aFence[i]);
+		glUnmapNamedBuffer(m_aBufReadback[i]);
+	}
+	glDeleteBuffers(kNumReadbacks, m_aBufReadback.data());
+	glDeleteBuffers(1, &m_bufCoverage);
+}
+
+void ShadowAtlas::Allocate(std::vector<U32> aSize) {
+	// budget, the farthest of largest ones gives up half first
+	auto Area = [&aSize]() {
+		U64 area = 0;
+		for (U32 size : aSize)
+			area += U64(size) * size;
+		return area;
+	};
+	while (Area() > U64(kSize) * kSize) {
+		U32& rSizeLargest = *std::max_element(aSize.rbegin(), aSize.rend());
+		assert(rSizeLargest > kSizeRectMin && "too many owners for atlas");
+		rSizeLargest /= 2;
+	}
+
+	for (U32 i = aSize.size(); i < m_aRect.size(); i++) {
+		if (m_aRect[i].m_size != 0)
+			Free(m_aRect[i]);
+	}
+	m_aRect.resize(aSize.size(), Rect{ 0, 0, 0 });
+
+	// largest first, so allocation from scratch never fails
+	std::vector<U32> aIdxOwner(aSize.size());
+	std::iota(aIdxOwner.begin(), aIdxOwner.end(), 0);
+	std::stable_sort(aIdxOwner.begin(), aIdxOwner.end(), [&aSize](U32 a, U32 b) { return aSize[a] > aSize[b]; });
+
+	for (U32 i : aIdxOwner) {
+		if (m_aRect[i].m_size != 0 && m_aRect[i].m_size != aSize[i]) {
+			Free(m_aRect[i]);
+			m_aRect[i].m_size = 0;
+		}
+	}
+	for (U32 i : aIdxOwner) {
+		if (m_aRect[i].m_size == 0 && !Alloc(aSize[i], m_aRect[i])) {
+			// fragmented
+			Reset();
+			for (U32 j : aIdxOwner)
+				Alloc(aSize[j], m_aRect[j]);
+			return;
+		}
+	}
+}
+
+Vec4 ShadowAtlas::GetRectUv(U32 idxOwner) const {
+	const Rect& rRect = m_aRect[idxOwner];
+	return Vec4(rRect.m_x, rRect.m_y, rRect.m_size, rRect.m_size) / F32(kSize);
+}
+
+void ShadowAtlas::MeasureCoverage(GLU hiZ, U32 level, U32 width, U32 height, const F32* aVsLimitsCascade, F32 nearPlane) {
+	// oldest readback is kNumReadbacks frames old, so waiting for it practically never blocks
+	GLsync& rFence = m_aFence[m_idxReadback];
+	if (rFence != nullptr) {
+		glClientWaitSync(rFence, GL_SYNC_FLUSH_COMMANDS_BIT, ~0ull);
+		glDeleteSync(rFence);
+		std::copy(m_aMappedReadback[m_idxReadback], m_aMappedReadback[m_idxReadback] + kMaxCascades, m_aCoverage.begin());
+		m_hasCoverage = true;
+	}
+
+	const U32 zero = 0;
+	glClearNamedBufferData(m_bufCoverage, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	m_passCoverage.Use();
+	m_passCoverage.SetInt("Level", level);
+	m_passCoverage.SetInt("WidthLevel", width);
+	m_passCoverage.SetInt("HeightLevel", height);
+	m_passCoverage.SetUInt("NumCascades", m_numCascades);
+	m_passCoverage.SetFloatArr("AVsLimitsCascade", aVsLimitsCascade, m_numCascades + 1);
+	m_passCoverage.SetFloat("Near", nearPlane);
+	g_stateCache.BindTextureUnit(0, hiZ);
+	g_stateCache.BindSampler(0, 0); // texelFetch of level
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_bufCoverage);
+	glDispatchCompute((width + kSizeGroup - 1) / kSizeGroup, (height + kSizeGroup - 1) / kSizeGroup, 1);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	glCopyNamedBufferSubData(m_bufCoverage, m_aBufReadback[m_idxReadback], 0, 0, kMaxCascades * sizeof(U32));
+	rFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_idxReadback = (m_idxReadback + 1) % kNumReadbacks;
+}
+
+std::vector<U32> ShadowAtlas::GetSizesCascades() const {
+	std::vector<U32> aSize(m_numCascades, kSizeRectMax);
+	const U32 coverageMax = *std::max_element(m_aCoverage.begin(), m_aCoverage.begin() + m_numCascades);
+	if (!m_hasCoverage || coverageMax == 0)
+		return aSize;
+
+	for (U32 i = 0; i < m_numCascades; i++) {
+		const F32 sizeIdeal = kSizeRectMax * sqrtf(F32(m_aCoverage[i]) / coverageMax);
+		U32 size = kSizeRectMin;
+		while (size < sizeIdeal && size < kSizeRectMax)
+			size *= 2;
+		// shrinks only well below current size, so it doesn't alternate around power of two
+		const U32 sizeCurrent = i < m_aRect.size() ? m_aRect[i].m_size : 0;
+		if (size < sizeCurrent && sizeIdeal > 0.4f * sizeCurrent)
+			size = sizeCurrent;
+		aSize[i] = size;
+	}
+	return aSize;
+}
+
+Bool ShadowAtlas::Alloc(U32 size, Rect& rRect) {
+	U32 level = 0;
+	while ((kSizeRectMax >> level) > size)
+		level++;
+	assert((kSizeRectMax >> level) == size && level < kNumLevels && "size has to be power of two in range");
+
+	// smallest free rect that fits, split down to size
+	I32 levelFree = level;
+	while (levelFree >= 0 && m_aFree[levelFree].empty())
+		levelFree--;
+	if (levelFree < 0)
+		return false;
+	rRect = m_aFree[levelFree].back();
+	m_aFree[levelFree].pop_back();
+	for (U32 i = levelFree + 1; i <= level; i++) {
+		const U32 sizeChild = kSizeRectMax >> i;
+		m_aFree[i].push_back({ rRect.m_x + sizeChild, rRect.m_y, sizeChild });
+		m_aFree[i].push_back({ rRect.m_x, rRect.m_y + sizeChild, sizeChild });
+		m_aFree[i].push_back({ rRect.m_x + sizeChild, rRect.m_y + sizeChild, sizeChild });
+		rRect.m_size = sizeChild;
+	}
+	return true;
+}
+
+void ShadowAtlas::Free(const Rect& rRect) {
+	U32 level = 0;
+	while ((kSizeRectMax >> level) > rRect.m_size)
+		level++;
+	std::vector<Rect>& rAFree = m_aFree[level];
+	rAFree.push_back(rRect);
+	if (level == 0)
+		return;
+
+	// merge with buddies when all of them are free
+	const U32 sizeParent = rRect.m_size * 2;
+	const Rect parent = { rRect.m_x & ~(sizeParent - 1), rRect.m_y & ~(sizeParent - 1), sizeParent };
+	auto IsBuddy = [&parent](const Rect& r) { return (r.m_x & ~(r.m_size * 2 - 1)) == parent.m_x && (r.m_y & ~(r.m_size * 2 - 1)) == parent.m_y; };
+	if (std::count_if(rAFree.begin(), rAFree.end(), IsBuddy) != 4)
+		return;
+	rAFree.erase(std::remove_if(rAFree.begin(), rAFree.end(), IsBuddy), rAFree.end());
+	Free(parent);
+}
+
+void ShadowAtlas::Reset() {
+	for (std::vector<Rect>& rAFree : m_aFree)
+		rAFree.clear();
+	for (U32 y = 0; y < kSize; y += kSizeRectMax) {
+		for (U32 x = 0; x < kSize; x += kSizeRectMax)
+			m_aFree[0].push_back({ x, y, kSizeRectMax });
+	}
+	for (Rect& rRect : m_aRect)
+		rRect.m_size = 0;
+}
\ No newline at end of file
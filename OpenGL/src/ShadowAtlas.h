@@ -0,0 +1,68 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Shader.h"		// Shader
+
+#include <array>		// std::array
+#include <vector>		// std::vector
+
+// Allocator of square kSize x kSize depth texture shared by shadow maps (cascades first, local lights can follow them):
+// each owner gets power of two rect from buddy allocator, whole budget fits because sizes are reduced to its area.
+// Rects of owners keeping their size stay where they are, the rest is allocated again, everything only when free
+// space is too fragmented. Sizes of cascades follow screen coverage measured on hi-Z and read back a few frames later.
+class ShadowAtlas
+{
+public:
+	static constexpr U32 kSize = 4096;
+	static constexpr U32 kSizeRectMax = 2048;
+	// tiles of ShadowMapMinMax and used levels of ShadowMapEvsm don't cross rects that are at least this big
+	static constexpr U32 kSizeRectMin = 256;
+
+	struct Rect {
+		U32 m_x;
+		U32 m_y;
+		U32 m_size;
+	};
+
+	explicit ShadowAtlas(U32 numCascades);
+	~ShadowAtlas();
+	ShadowAtlas(const ShadowAtlas&) = delete;
+	ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+	// sizes (power of two in [kSizeRectMin, kSizeRectMax]) per owner, largest ones are halved until they fit
+	void Allocate(std::vector<U32> aSize);
+	const Rect& GetRect(U32 idxOwner) const { return m_aRect[idxOwner]; }
+	// offset in xy and size in zw of rect in uv of atlas
+	Vec4 GetRectUv(U32 idxOwner) const;
+
+	// counts texels of level of hi-Z (closest depth, width x height of them cover screen) per cascade by view depth
+	// limits (numCascades + 1 of them), queues their readback
+	void MeasureCoverage(GLU hiZ, U32 level, U32 width, U32 height, const F32* aVsLimitsCascade, F32 nearPlane);
+	// rect sizes by coverage of a few frames ago (cascades are owners 0 to numCascades - 1): area of rect follows
+	// coverage, the most covered cascade gets kSizeRectMax (all do until first readback arrives)
+	std::vector<U32> GetSizesCascades() const;
+
+private:
+	static constexpr U32 kNumLevels = 4;	// of buddy allocator, kSizeRectMax >> (kNumLevels - 1) is kSizeRectMin
+	static constexpr U32 kNumReadbacks = 3;
+	static constexpr U32 kMaxCascades = 8;	// as in shadowCoverage.comp
+
+	Bool Alloc(U32 size, Rect& rRect);
+	void Free(const Rect& rRect);
+	void Reset();
+
+	std::vector<Rect> m_aRect;
+	// free rects per level of size kSizeRectMax >> level, at level 0 whole quadrants of atlas
+	std::array<std::vector<Rect>, kNumLevels> m_aFree;
+
+	Shader m_passCoverage;
+	U32 m_numCascades;
+	GLU m_bufCoverage = 0;
+	std::array<GLU, kNumReadbacks> m_aBufReadback = {};
+	std::array<const U32*, kNumReadbacks> m_aMappedReadback = {};
+	std::array<GLsync, kNumReadbacks> m_aFence = {};
+	U32 m_idxReadback = 0;
+	std::array<U32, kMaxCascades> m_aCoverage = {};
+	Bool m_hasCoverage = false;
+};
\ No newline at end of file
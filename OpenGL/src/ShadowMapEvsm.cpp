@@ -0,0 +1,50 @@
+#include "ShadowMapEvsm.h"
+
+#include <cmath>		// std::log2
+
+namespace {
+	constexpr U32 kSizeGroup = 8;	// work group of shadowEvsm.comp and shadowEvsmBlur.comp in x and y
+}
+
+ShadowMapEvsm::ShadowMapEvsm(U32 sizeShadowMap, U32 numCascades)
+	: m_passConvert("shadowEvsm.comp"), m_passBlur("shadowEvsmBlur.comp"), m_size(sizeShadowMap / 2), m_numCascades(numCascades)
+{
+	const U32 numLevels = U32(std::log2(m_size)) + 1;
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+	glTextureStorage2D(m_texture, numLevels, GL_RGBA32F, m_size, m_size);
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_textureBlur);
+	glTextureStorage2D(m_textureBlur, 1, GL_RGBA32F, m_size, m_size);
+}
+
+ShadowMapEvsm::~ShadowMapEvsm() {
+	g_stateCache.DeleteTexture(m_textureBlur);
+	g_stateCache.DeleteTexture(m_texture);
+}
+
+void ShadowMapEvsm::Build(GLU shadowMap, const Vec4* aRectCascade) {
+	const U32 numGroups = (m_size + kSizeGroup - 1) / kSizeGroup;
+	g_stateCache.BindSampler(0, 0); // texelFetch, but sampler with compare mode would still apply
+
+	// map -> m_texture -> horizontally m_textureBlur -> vertically m_texture
+	g_stateCache.BindTextureUnit(0, shadowMap);
+	glBindImageTexture(0, m_texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	m_passConvert.Use();
+	glDispatchCompute(numGroups, numGroups, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	m_passBlur.Use();
+	m_passBlur.SetVec4Arr("ARectCascade", aRectCascade, m_numCascades);
+	g_stateCache.BindTextureUnit(0, m_texture);
+	glBindImageTexture(0, m_textureBlur, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	m_passBlur.SetBool("Vertical", false);
+	glDispatchCompute(numGroups, numGroups, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	g_stateCache.BindTextureUnit(0, m_textureBlur);
+	glBindImageTexture(0, m_texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	m_passBlur.SetBool("Vertical", true);
+	glDispatchCompute(numGroups, numGroups, 1);
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	glGenerateTextureMipmap(m_texture);
+}
\ No newline at end of file
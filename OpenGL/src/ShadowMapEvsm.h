@@ -0,0 +1,30 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Shader.h"		// Shader
+
+// Prefiltered alternative to disc PCSS of cascaded shadow map: exponential variance shadow map with positive and
+// negative warp (EVSM4, RGBA32F in half resolution of shadow atlas), blurred by separable filter within rects of
+// cascades and mipmapped, so blocker search and filter of any width are one trilinear fetch each (see shadows.gl).
+class ShadowMapEvsm
+{
+public:
+	ShadowMapEvsm(U32 sizeShadowMap, U32 numCascades);
+	~ShadowMapEvsm();
+	ShadowMapEvsm(const ShadowMapEvsm&) = delete;
+	ShadowMapEvsm& operator=(const ShadowMapEvsm&) = delete;
+
+	// after cascades were rendered to their rects (uv of atlas as in ShadowAtlas::GetRectUv), uses texture unit 0
+	void Build(GLU shadowMap, const Vec4* aRectCascade);
+
+	GLU GetTexture() const { return m_texture; }
+
+private:
+	Shader m_passConvert;
+	Shader m_passBlur;
+	U32 m_size;
+	U32 m_numCascades;
+	GLU m_texture = 0;
+	GLU m_textureBlur = 0;	// level 0 between directions of blur
+};
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "ShadowMapMinMax.h"
+
+#include <cassert>		// assert
+
+namespace {
+	constexpr U32 kSizeGroup = 8;	// work group of shadowMinMax.comp in x and y
+}
+
+ShadowMapMinMax::ShadowMapMinMax(U32 sizeShadowMap)
+	: m_passBuild("shadowMinMax.comp"), m_sizeLevel0(sizeShadowMap / kSizeTile)
+{
+	assert(sizeShadowMap % (kSizeTile << (kNumLevels - 1)) == 0 && "tiles of every level have to cover map exactly");
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+	glTextureStorage2D(m_texture, kNumLevels, GL_RG16, m_sizeLevel0, m_sizeLevel0);
+}
+
+ShadowMapMinMax::~ShadowMapMinMax() {
+	g_stateCache.DeleteTexture(m_texture);
+}
+
+void ShadowMapMinMax::Build(GLU shadowMap) {
+	m_passBuild.Use();
+	g_stateCache.BindSampler(0, 0); // texelFetch, but sampler with compare mode would still apply
+	for (U32 i = 0; i < kNumLevels; i++) {
+		// level 0 reduces tiles of map, the rest 2x2 texels of level above
+		g_stateCache.BindTextureUnit(0, i == 0 ? shadowMap : m_texture);
+		m_passBuild.SetInt("Level", i);
+		glBindImageTexture(0, m_texture, i, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16);
+		const U32 sizeLevel = m_sizeLevel0 >> i;
+		glDispatchCompute((sizeLevel + kSizeGroup - 1) / kSizeGroup, (sizeLevel + kSizeGroup - 1) / kSizeGroup, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Shader.h"		// Shader
+
+// Min/max pyramid of shadow atlas (RG16, x min, y max), tiles of blocker depth for PCSS. Tiles of used levels don't
+// cross rects of atlas (see ShadowAtlas::kSizeRectMin).
+// Texel (x, y) of level n covers kSizeTile << n texels of map in each direction. Values are unorm 16 bit as map is,
+// so they compare with receiver depth exactly as its texels: PCSS skips blocker search and filter where all texels
+// of search region are in front of receiver (fully lit) or all of them occlude it (fully shadowed).
+class ShadowMapMinMax
+{
+public:
+	static constexpr U32 kSizeTile = 8;		// as in shadows.gl
+	static constexpr U32 kNumLevels = 5;
+
+	explicit ShadowMapMinMax(U32 sizeShadowMap);
+	~ShadowMapMinMax();
+	ShadowMapMinMax(const ShadowMapMinMax&) = delete;
+	ShadowMapMinMax& operator=(const ShadowMapMinMax&) = delete;
+
+	// after cascades were rendered, uses texture unit 0
+	void Build(GLU shadowMap);
+
+	GLU GetTexture() const { return m_texture; }
+
+private:
+	Shader m_passBuild;
+	U32 m_sizeLevel0;
+	GLU m_texture = 0;
+};
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "StateCache.h"
+
+#include <iostream>		// std::cout
+
+StateCache g_stateCache;
+
+void StateCache::Invalidate() {
+	m_aTexture.fill(kUnknown);
+	m_aSampler.fill(kUnknown);
+	m_aCapability.fill(kUnknown);
+	m_program		= kUnknown;
+	m_framebuffer	= kUnknown;
+	m_vertexArray	= kUnknown;
+	m_drawIndirectBuffer = kUnknown;
+	m_depthFunc		= kUnknown;
+	m_depthMask		= kUnknown;
+	m_cullFace		= kUnknown;
+	m_blendSrc		= kUnknown;
+	m_blendDst		= kUnknown;
+	m_viewport.fill(-1);
+}
+
+void StateCache::EndFrame() {
+	m_aRequestedLastFrame = m_aRequested;
+	m_aIssuedLastFrame = m_aIssued;
+	m_aRequested.fill(0);
+	m_aIssued.fill(0);
+}
+
+void StateCache::PrintStats() const {
+	const char* aName[] = {
+		"texture", "sampler", "program", "framebuffer", "vertex array", "buffer",
+		"enable/disable", "depth", "cull", "blend", "viewport"
+	};
+	static_assert(sizeof(aName) / sizeof(aName[0]) == U32(Call::COUNT), "name every Call");
+
+	U32 requested = 0;
+	U32 issued = 0;
+	std::cout << "GL state calls (requested -> issued):\n";
+	for (U32 i = 0; i < U32(Call::COUNT); i++) {
+		std::cout << "\t" << aName[i] << ": " << m_aRequestedLastFrame[i] << " -> " << m_aIssuedLastFrame[i] << "\n";
+		requested += m_aRequestedLastFrame[i];
+		issued += m_aIssuedLastFrame[i];
+	}
+	std::cout << "\ttotal: " << requested << " -> " << issued << "\n";
+}
\ No newline at end of file
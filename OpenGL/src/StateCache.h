@@ -0,0 +1,191 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+
+#include <array>		// std::array
+#include <cassert>		// assert
+
+// Thin wrapper over OGL binding and fixed function state, which filters out redundant changes.
+// Render loop should set state only through it, otherwise cache goes out of sync with driver.
+// Passes declare state they need instead of restoring it afterwards, so consecutive passes with
+// the same requirements don't touch OGL at all.
+class StateCache
+{
+public:
+	static constexpr U32 kMaxTextureUnits = 16;
+
+	enum class Call : U32 {
+		TEXTURE,
+		SAMPLER,
+		PROGRAM,
+		FRAMEBUFFER,
+		VERTEX_ARRAY,
+		BUFFER,
+		CAPABILITY,
+		DEPTH,
+		CULL,
+		BLEND,
+		VIEWPORT,
+		COUNT
+	};
+
+	StateCache() {
+		Invalidate();
+	}
+
+	// forget everything, so next request for each state is always issued
+	void Invalidate();
+
+	void BindTextureUnit(GLU unit, GLU texture) {
+		assert(unit < kMaxTextureUnits);
+		if (IsRedundant(Call::TEXTURE, m_aTexture[unit], texture))
+			return;
+		glBindTextureUnit(unit, texture);
+	}
+
+	// deleting unbinds texture from its units, forget it there, so texture which reuses the name gets bound
+	void DeleteTexture(GLU texture) {
+		for (U32& rTexture : m_aTexture)
+			if (rTexture == texture)
+				rTexture = 0;
+		glDeleteTextures(1, &texture);
+	}
+
+	void BindSampler(GLU unit, GLU sampler) {
+		assert(unit < kMaxTextureUnits);
+		if (IsRedundant(Call::SAMPLER, m_aSampler[unit], sampler))
+			return;
+		glBindSampler(unit, sampler);
+	}
+
+	void UseProgram(GLU program) {
+		if (IsRedundant(Call::PROGRAM, m_program, program))
+			return;
+		glUseProgram(program);
+	}
+
+	// binds both draw and read framebuffer
+	void BindFramebuffer(GLU fbo) {
+		if (IsRedundant(Call::FRAMEBUFFER, m_framebuffer, fbo))
+			return;
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
+
+	void BindVertexArray(GLU vao) {
+		if (IsRedundant(Call::VERTEX_ARRAY, m_vertexArray, vao))
+			return;
+		glBindVertexArray(vao);
+	}
+
+	void BindDrawIndirectBuffer(GLU buffer) {
+		if (IsRedundant(Call::BUFFER, m_drawIndirectBuffer, buffer))
+			return;
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+	}
+
+	// only capabilities listed in IdxCapability() are supported
+	void SetEnabled(GLE capability, Bool enabled) {
+		const U32 value = enabled ? 1 : 0;
+		if (IsRedundant(Call::CAPABILITY, m_aCapability[IdxCapability(capability)], value))
+			return;
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+	}
+	void Enable(GLE capability)	 { SetEnabled(capability, true);  }
+	void Disable(GLE capability) { SetEnabled(capability, false); }
+
+	void DepthFunc(GLE func) {
+		if (IsRedundant(Call::DEPTH, m_depthFunc, func))
+			return;
+		glDepthFunc(func);
+	}
+
+	void DepthMask(Bool write) {
+		if (IsRedundant(Call::DEPTH, m_depthMask, write ? 1u : 0u))
+			return;
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+
+	void CullFace(GLE face) {
+		if (IsRedundant(Call::CULL, m_cullFace, face))
+			return;
+		glCullFace(face);
+	}
+
+	void BlendFunc(GLE src, GLE dst) {
+		m_aRequested[U32(Call::BLEND)]++;
+		if (m_blendSrc == src && m_blendDst == dst)
+			return;
+		m_blendSrc = src;
+		m_blendDst = dst;
+		m_aIssued[U32(Call::BLEND)]++;
+		glBlendFunc(src, dst);
+	}
+
+	void Viewport(GLI x, GLI y, GLS width, GLS height) {
+		m_aRequested[U32(Call::VIEWPORT)]++;
+		const std::array<GLI, 4> viewport = { x, y, width, height };
+		if (m_viewport == viewport)
+			return;
+		m_viewport = viewport;
+		m_aIssued[U32(Call::VIEWPORT)]++;
+		glViewport(x, y, width, height);
+	}
+
+	// latch counters of finished frame and start counting from 0
+	void EndFrame();
+	// prints counters of last finished frame
+	void PrintStats() const;
+
+private:
+	static constexpr U32 kUnknown = ~0u;
+	static constexpr U32 kNumCapabilities = 6;
+
+	static U32 IdxCapability(GLE capability) {
+		switch (capability) {
+		case GL_DEPTH_TEST:			 return 0;
+		case GL_CULL_FACE:			 return 1;
+		case GL_BLEND:				 return 2;
+		case GL_POLYGON_OFFSET_FILL: return 3;
+		case GL_FRAMEBUFFER_SRGB:	 return 4;
+		case GL_SCISSOR_TEST:		 return 5;
+		default:
+			assert(false && "capability not tracked by StateCache");
+			return 0;
+		}
+	}
+
+	Bool IsRedundant(Call call, U32& rCached, U32 requested) {
+		m_aRequested[U32(call)]++;
+		if (rCached == requested)
+			return true;
+		rCached = requested;
+		m_aIssued[U32(call)]++;
+		return false;
+	}
+
+	std::array<U32, kMaxTextureUnits> m_aTexture;
+	std::array<U32, kMaxTextureUnits> m_aSampler;
+	std::array<U32, kNumCapabilities> m_aCapability;
+	U32 m_program;
+	U32 m_framebuffer;
+	U32 m_vertexArray;
+	U32 m_drawIndirectBuffer;
+	U32 m_depthFunc;
+	U32 m_depthMask;
+	U32 m_cullFace;
+	U32 m_blendSrc;
+	U32 m_blendDst;
+	std::array<GLI, 4> m_viewport;
+
+	std::array<U32, U32(Call::COUNT)> m_aRequested = {};
+	std::array<U32, U32(Call::COUNT)> m_aIssued = {};
+	std::array<U32, U32(Call::COUNT)> m_aRequestedLastFrame = {};
+	std::array<U32, U32(Call::COUNT)> m_aIssuedLastFrame = {};
+};
+
+// one OGL context, one cache
+extern StateCache g_stateCache;
\ No newline at end of file
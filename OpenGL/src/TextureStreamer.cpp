@@ -0,0 +1,435 @@
+#include "TextureStreamer.h"
+#include "StateCache.h"			// g_stateCache
+#include "Profiler.h"			// ProfileScope
+
+//file loader
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_WINDOWS_UTF8		// WideCharToMultiByte
+#include <stb_image.h>			// stbi_load(), stbi_info(), stbi_convert_wchar_to_utf8()
+
+#include <glm/glm.hpp>			// glm::clamp
+
+#include <algorithm>			// std::max, std::min, std::sort
+#include <cassert>				// assert
+#include <cstring>				// std::memcpy
+#include <iomanip>				// std::setprecision
+#include <iostream>				// std::cout
+
+namespace {
+	struct Image {
+		stbi_uc* m_pData = nullptr;
+		int m_width = 0;
+		int m_height = 0;
+		int m_numChannels = 0;
+	};
+
+	// shown until texels stream in: grey diffuse, no specular, flat normal
+	const U8 kAPlaceholder[3][4] = { { 128, 128, 128, 255 }, { 0, 0, 0, 255 }, { 128, 128, 255, 255 } };
+
+	// feedback is log2 of UV per pixel, stored as (log2 + kFootprintBias) * kFootprintStepsPerLevel, same as in geometry.frag
+	const F32 kFootprintBias = 32;
+	const F32 kFootprintStepsPerLevel = 16;
+	const U32 kNoFootprint = ~0u;
+
+	struct PathUtf8 {
+		char m_buffer[1024];
+		explicit PathUtf8(const Path& path) { stbi_convert_wchar_to_utf8(&m_buffer[0], 1024, path.c_str()); }
+	};
+
+	// CPU only, so it can run in job
+	Image DecodeImage(const Path& path) {
+		Image image;
+		image.m_pData = stbi_load(PathUtf8(path).m_buffer, &image.m_width, &image.m_height, &image.m_numChannels, 0);
+		return image;
+	}
+
+	void FreeImage(Image& rImage) {
+		stbi_image_free(rImage.m_pData);
+		rImage.m_pData = nullptr;
+	}
+
+	Bool GetTextureFormat(int numChannels, GLE& rFormat, GLE& rInternalFormat) {
+		if (numChannels == 1) {
+			rFormat = GL_RED;
+			rInternalFormat = GL_R8;
+		} else if (numChannels == 3) {
+			rFormat = GL_RGB;
+			rInternalFormat = GL_RGB8;
+		} else if (numChannels == 4) {
+			rFormat = GL_RGBA;
+			rInternalFormat = GL_RGBA8;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	GLS GetNumLevels(int width, int height) {
+		return GLS(log2f(F32(std::max(width, height)))) + 1;
+	}
+
+	// 2x2 box filter, like glGenerateMipmap of linear formats, odd last row/column is clamped
+	void DownsampleImage(const U8* pSrc, int width, int height, int numChannels, U8* pDst) {
+		const int widthDst = std::max(width / 2, 1);
+		const int heightDst = std::max(height / 2, 1);
+		for (int y = 0; y < heightDst; y++) {
+			const U8* pRow0 = pSrc + Size(std::min(y * 2, height - 1)) * width * numChannels;
+			const U8* pRow1 = pSrc + Size(std::min(y * 2 + 1, height - 1)) * width * numChannels;
+			for (int x = 0; x < widthDst; x++) {
+				const int x0 = std::min(x * 2, width - 1) * numChannels;
+				const int x1 = std::min(x * 2 + 1, width - 1) * numChannels;
+				for (int c = 0; c < numChannels; c++)
+					*pDst++ = U8((pRow0[x0 + c] + pRow0[x1 + c] + pRow1[x0 + c] + pRow1[x1 + c] + 2) / 4);
+			}
+		}
+	}
+
+	// background job: decodes image and writes its levels [levelFirst, levelEnd) into staging memory,
+	// as copies into texture whose level 0 is levelFirst,
+	// mips are built from CPU copies, because staging memory is write combined
+	Bool DecodeIntoStaging(const Path& path, GLU texture, int width, int height, int numChannels, GLE format, U32 levelFirst, U32 levelEnd,
+						   const UploadManager::Allocation& rAllocation, std::vector<UploadManager::Copy>& rACopy) {
+		Image image = DecodeImage(path);
+		if (image.m_pData == nullptr || image.m_width != width || image.m_height != height || image.m_numChannels != numChannels) {
+			std::cout << "Texture failed to load at path: " << path << std::endl;
+			FreeImage(image);
+			return false;
+		}
+
+		const U8* pLevel = image.m_pData;
+		std::vector<U8> aLevel;
+		std::vector<U8> aLevelNext;
+		Size offset = 0;
+		for (U32 level = 0; level < levelEnd; level++) {
+			if (level >= levelFirst) {
+				const Size size = Size(width) * height * numChannels;
+				std::memcpy(rAllocation.m_pData + offset, pLevel, size);
+				rACopy.push_back(UploadManager::CopyToTexture(texture, GLI(level - levelFirst), width, height, format, offset, size));
+				offset += size;
+			}
+			if (level + 1 == levelEnd)
+				break;
+			aLevelNext.resize(Size(std::max(width / 2, 1)) * std::max(height / 2, 1) * numChannels);
+			DownsampleImage(pLevel, width, height, numChannels, aLevelNext.data());
+			aLevel.swap(aLevelNext);
+			pLevel = aLevel.data();
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		FreeImage(image);
+		return true;
+	}
+
+	// 0 when image failed to decode
+	GLU TextureFromImage(const Image& rImage, const Path& path, bool generateMipMap = true) {
+		if (rImage.m_pData == nullptr) {
+			std::cout << "Texture failed to load at path: " << path << std::endl;
+			return 0;
+		}
+		GLE format;
+		GLE	internalFormat;
+		if (!GetTextureFormat(rImage.m_numChannels, format, internalFormat))
+			std::cout << "WARNING! Wrong number of channels for: " << path << "\n";
+
+		GLU textureID;
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+		GLS levels = 1;
+		if (generateMipMap)
+			levels = GetNumLevels(rImage.m_width, rImage.m_height);
+		glTextureStorage2D(textureID, levels, internalFormat, rImage.m_width, rImage.m_height);
+		glTextureSubImage2D(textureID, 0, 0, 0, rImage.m_width, rImage.m_height, format, GL_UNSIGNED_BYTE, rImage.m_pData);
+		if (generateMipMap)
+			glGenerateTextureMipmap(textureID);
+		return textureID;
+	}
+
+	F64 GetMegabytes(Size bytes) {
+		return F64(bytes) / (1 << 20);
+	}
+}
+
+TextureStreamer::TextureStreamer(UploadManager& rUploadManager, Size budget)
+	: m_pUploadManager(&rUploadManager), m_budget(budget)
+{
+	const Size sizeFeedback = kMaxFeedbackSlots * sizeof(U32);
+	glCreateBuffers(1, &m_bufFeedback);
+	glNamedBufferStorage(m_bufFeedback, sizeFeedback, nullptr, 0);
+	glClearNamedBufferData(m_bufFeedback, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &kNoFootprint);
+
+	// persistently mapped, so reading finished copies doesn't stall
+	for (U32 i = 0; i < kNumReadbacks; i++) {
+		const GLE flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &m_aBufReadback[i]);
+		glNamedBufferStorage(m_aBufReadback[i], sizeFeedback, nullptr, flags);
+		m_aMappedReadback[i] = (const U32*)glMapNamedBufferRange(m_aBufReadback[i], 0, sizeFeedback, flags);
+	}
+}
+
+TextureStreamer::~TextureStreamer() {
+	Finish();
+	for (const Texture& rTexture : m_aTexture)
+		g_stateCache.DeleteTexture(rTexture.m_texture);
+	for (U32 i = 0; i < kNumReadbacks; i++) {
+		if (m_aFence[i] != nullptr)
+			glDeleteSync(m_aFence[i]);
+		glUnmapNamedBuffer(m_aBufReadback[i]);
+	}
+	glDeleteBuffers(kNumReadbacks, m_aBufReadback.data());
+	glDeleteBuffers(1, &m_bufFeedback);
+}
+
+Bool TextureStreamer::ReadHeader(const Path& path, int& rWidth, int& rHeight, int& rNumChannels) {
+	return stbi_info(PathUtf8(path).m_buffer, &rWidth, &rHeight, &rNumChannels) != 0;
+}
+
+U32 TextureStreamer::Add(const Path& path, int width, int height, int numChannels, Role role) {
+	Texture texture;
+	texture.m_path = path;
+	texture.m_width = width;
+	texture.m_height = height;
+	texture.m_numChannels = numChannels;
+	texture.m_numLevels = GetNumLevels(width, height);
+	texture.m_levelTail = 0;
+	while (texture.m_levelTail + 1 < texture.m_numLevels && U32(std::max(width >> texture.m_levelTail, height >> texture.m_levelTail)) > kMaxSizeTail)
+		texture.m_levelTail++;
+	texture.m_levelFinest = 0;
+	while (texture.m_levelFinest + 1 < texture.m_numLevels
+		   && GetSizeStaging(texture, texture.m_levelFinest, texture.m_numLevels) > m_pUploadManager->GetSizeRing())
+		texture.m_levelFinest++;
+	if (!GetTextureFormat(numChannels, texture.m_format, texture.m_internalFormat)) {
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		texture.m_failed = true;
+	} else if (texture.m_levelFinest > 0) {
+		std::cout << "WARNING! Texture doesn't fit into staging memory, streaming it from level " << texture.m_levelFinest << ": " << path << "\n";
+	}
+
+	// 1x1 placeholder until levels stream in
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture.m_texture);
+	glTextureStorage2D(texture.m_texture, 1, GL_RGBA8, 1, 1);
+	glClearTexImage(texture.m_texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, kAPlaceholder[U32(role)]);
+	texture.m_levelResident = texture.m_numLevels;
+	texture.m_levelWanted = texture.m_levelTail;
+
+	m_aTexture.push_back(texture);
+	return U32(m_aTexture.size() - 1);
+}
+
+U32 TextureStreamer::AddFeedbackSlot(const std::vector<U32>& rAIdTexture) {
+	assert(m_aTextureOfSlot.size() < kMaxFeedbackSlots && "increase kMaxFeedbackSlots");
+	m_aTextureOfSlot.push_back(rAIdTexture);
+	return U32(m_aTextureOfSlot.size() - 1);
+}
+
+void TextureStreamer::Update() {
+	ProfileScope profile("stream: update textures");
+	m_frame++;
+	ApplyFeedback();
+
+	// the most missing levels first
+	std::vector<U32> aIdToLoad;
+	for (U32 id = 0; id < m_aTexture.size(); id++) {
+		const Texture& rTexture = m_aTexture[id];
+		if (!rTexture.m_loading && !rTexture.m_failed && GetLevelWanted(rTexture) < rTexture.m_levelResident)
+			aIdToLoad.push_back(id);
+	}
+	std::sort(aIdToLoad.begin(), aIdToLoad.end(), [this](U32 a, U32 b) {
+		const Texture& rA = m_aTexture[a];
+		const Texture& rB = m_aTexture[b];
+		return rA.m_levelResident - GetLevelWanted(rA) > rB.m_levelResident - GetLevelWanted(rB);
+	});
+
+	// half of threads stay free for per-frame jobs
+	const U32 maxNumDecoding = std::max(g_jobSystem.GetNumThreads() / 2, 1u);
+	Bool droppedUnwanted = false;
+	for (U32 id : aIdToLoad) {
+		if (m_counterDecoding.load() >= maxNumDecoding)
+			break;
+		const Texture& rTexture = m_aTexture[id];
+		auto Fits = [this, &rTexture](U32 levelFirst) {
+			return m_bytesResident + m_bytesLoading + GetSizeVram(rTexture, levelFirst) - GetSizeVram(rTexture, rTexture.m_levelResident) <= m_budget;
+		};
+		// levels past tail only within budget, after levels nobody wants anymore are dropped
+		U32 levelFirst = GetLevelWanted(rTexture);
+		if (!Fits(levelFirst) && !droppedUnwanted) {
+			DropUnwantedLevels();
+			droppedUnwanted = true;
+		}
+		while (levelFirst < std::min(rTexture.m_levelTail, rTexture.m_levelResident) && !Fits(levelFirst))
+			levelFirst++;
+		if (levelFirst >= rTexture.m_levelResident)
+			continue;
+		if (!StartLoad(id, levelFirst))
+			break; // staging memory is full
+	}
+}
+
+void TextureStreamer::BeginFeedback() const {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBindingFeedback, m_bufFeedback);
+}
+
+void TextureStreamer::EndFeedback() {
+	const Size sizeFeedback = m_aTextureOfSlot.size() * sizeof(U32);
+	if (sizeFeedback == 0)
+		return;
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	// oldest readback is kNumReadbacks frames old, so waiting for it practically never blocks
+	GLsync& rFence = m_aFence[m_idxReadback];
+	if (rFence != nullptr) {
+		glClientWaitSync(rFence, GL_SYNC_FLUSH_COMMANDS_BIT, ~0ull);
+		glDeleteSync(rFence);
+		const U32* pMapped = m_aMappedReadback[m_idxReadback];
+		m_aFootprint.assign(pMapped, pMapped + m_aTextureOfSlot.size());
+		m_hasFeedback = true;
+	}
+	glCopyNamedBufferSubData(m_bufFeedback, m_aBufReadback[m_idxReadback], 0, 0, sizeFeedback);
+	glClearNamedBufferSubData(m_bufFeedback, GL_R32UI, 0, sizeFeedback, GL_RED_INTEGER, GL_UNSIGNED_INT, &kNoFootprint);
+	rFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_idxReadback = (m_idxReadback + 1) % kNumReadbacks;
+}
+
+void TextureStreamer::Finish() {
+	g_jobSystem.Wait(m_counterDecoding);
+	m_pUploadManager->Flush();
+}
+
+void TextureStreamer::PrintStats() const {
+	Size bytesAllLevels = 0;
+	Size bytesWanted = 0;
+	U32 numLoading = 0;
+	for (const Texture& rTexture : m_aTexture) {
+		if (rTexture.m_failed)
+			continue;
+		bytesAllLevels += GetSizeVram(rTexture, rTexture.m_levelFinest);
+		bytesWanted += GetSizeVram(rTexture, GetLevelWanted(rTexture));
+		numLoading += rTexture.m_loading ? 1 : 0;
+	}
+	std::cout << std::fixed << std::setprecision(1)
+			  << "Texture streaming: " << GetMegabytes(m_bytesResident) << " MB resident, " << GetMegabytes(bytesWanted) << " MB wanted, "
+			  << GetMegabytes(bytesAllLevels) << " MB all levels, budget " << GetMegabytes(m_budget) << " MB, "
+			  << numLoading << " loading\n"
+			  << std::defaultfloat;
+}
+
+Size TextureStreamer::GetSizeVram(const Texture& rTexture, U32 levelFirst) {
+	const Size bytesPerTexel = rTexture.m_numChannels == 3 ? 4 : rTexture.m_numChannels;
+	Size size = 0;
+	for (U32 level = levelFirst; level < rTexture.m_numLevels; level++)
+		size += Size(std::max(rTexture.m_width >> level, 1)) * std::max(rTexture.m_height >> level, 1) * bytesPerTexel;
+	return size;
+}
+
+Size TextureStreamer::GetSizeStaging(const Texture& rTexture, U32 levelFirst, U32 levelEnd) {
+	Size size = 0;
+	for (U32 level = levelFirst; level < levelEnd; level++)
+		size += Size(std::max(rTexture.m_width >> level, 1)) * std::max(rTexture.m_height >> level, 1) * rTexture.m_numChannels;
+	return size;
+}
+
+U32 TextureStreamer::GetLevelWanted(const Texture& rTexture) const {
+	const U32 level = m_frame - rTexture.m_frameWanted <= kFramesKeepWanted ? rTexture.m_levelWanted : rTexture.m_levelTail;
+	return std::max(level, rTexture.m_levelFinest);
+}
+
+void TextureStreamer::ApplyFeedback() {
+	if (!m_hasFeedback)
+		return;
+	m_hasFeedback = false;
+	for (Size i = 0; i < m_aFootprint.size(); i++) {
+		if (m_aFootprint[i] == kNoFootprint)
+			continue;
+		const F32 log2Footprint = F32(m_aFootprint[i]) / kFootprintStepsPerLevel - kFootprintBias;
+		for (U32 id : m_aTextureOfSlot[i]) {
+			Texture& rTexture = m_aTexture[id];
+			// level whose texel covers pixel, larger side, so non square textures don't get blurry
+			const F32 level = log2f(F32(std::max(rTexture.m_width, rTexture.m_height))) + log2Footprint;
+			const U32 levelRequested = U32(glm::clamp(level, 0.f, F32(rTexture.m_levelTail)));
+			// finer requests win, until they get old
+			if (levelRequested <= rTexture.m_levelWanted || m_frame - rTexture.m_frameWanted > kFramesKeepWanted) {
+				rTexture.m_levelWanted = levelRequested;
+				rTexture.m_frameWanted = m_frame;
+			}
+		}
+	}
+}
+
+GLU TextureStreamer::CreateWithResidentLevels(const Texture& rTexture, U32 levelFirst) const {
+	GLU texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, GLS(rTexture.m_numLevels - levelFirst), rTexture.m_internalFormat,
+					   std::max(rTexture.m_width >> levelFirst, 1), std::max(rTexture.m_height >> levelFirst, 1));
+	for (U32 level = std::max(levelFirst, rTexture.m_levelResident); level < rTexture.m_numLevels; level++)
+		glCopyImageSubData(rTexture.m_texture, GL_TEXTURE_2D, GLI(level - rTexture.m_levelResident), 0, 0, 0,
+						   texture, GL_TEXTURE_2D, GLI(level - levelFirst), 0, 0, 0,
+						   std::max(rTexture.m_width >> level, 1), std::max(rTexture.m_height >> level, 1), 1);
+	return texture;
+}
+
+void TextureStreamer::DropLevels(U32 idTexture, U32 levelFirst) {
+	Texture& rTexture = m_aTexture[idTexture];
+	assert(!rTexture.m_loading && levelFirst > rTexture.m_levelResident && levelFirst <= rTexture.m_levelTail);
+	const GLU texture = CreateWithResidentLevels(rTexture, levelFirst);
+	g_stateCache.DeleteTexture(rTexture.m_texture);
+	m_bytesResident -= GetSizeVram(rTexture, rTexture.m_levelResident) - GetSizeVram(rTexture, levelFirst);
+	rTexture.m_texture = texture;
+	rTexture.m_levelResident = levelFirst;
+	rTexture.m_generation++;
+}
+
+void TextureStreamer::DropUnwantedLevels() {
+	for (U32 id = 0; id < m_aTexture.size(); id++) {
+		const Texture& rTexture = m_aTexture[id];
+		const U32 levelWanted = GetLevelWanted(rTexture);
+		if (!rTexture.m_loading && levelWanted > rTexture.m_levelResident)
+			DropLevels(id, levelWanted);
+	}
+}
+
+Bool TextureStreamer::StartLoad(U32 idTexture, U32 levelFirst) {
+	Texture& rTexture = m_aTexture[idTexture];
+	const U32 levelEnd = rTexture.m_levelResident;
+	UploadManager::Allocation allocation;
+	if (!m_pUploadManager->TryAllocate(GetSizeStaging(rTexture, levelFirst, levelEnd), allocation))
+		return false;
+	// swapped in FinishLoad(), until then draws use the old one
+	const GLU texture = CreateWithResidentLevels(rTexture, levelFirst);
+	rTexture.m_loading = true;
+	m_bytesLoading += GetSizeVram(rTexture, levelFirst) - GetSizeVram(rTexture, rTexture.m_levelResident);
+
+	g_jobSystem.RunBackground("stream: decode texture", [this, idTexture, texture, levelFirst, levelEnd, allocation,
+														 path = rTexture.m_path, width = rTexture.m_width, height = rTexture.m_height,
+														 numChannels = rTexture.m_numChannels, format = rTexture.m_format] {
+		std::vector<UploadManager::Copy> aCopy;
+		const Bool decoded = DecodeIntoStaging(path, texture, width, height, numChannels, format, levelFirst, levelEnd, allocation, aCopy);
+		m_pUploadManager->Commit(allocation, std::move(aCopy), [this, idTexture, texture, levelFirst, decoded] {
+			FinishLoad(idTexture, texture, levelFirst, decoded);
+		});
+	}, m_counterDecoding);
+	return true;
+}
+
+void TextureStreamer::FinishLoad(U32 idTexture, GLU texture, U32 levelFirst, Bool decoded) {
+	Texture& rTexture = m_aTexture[idTexture];
+	const Size bytesAdded = GetSizeVram(rTexture, levelFirst) - GetSizeVram(rTexture, rTexture.m_levelResident);
+	rTexture.m_loading = false;
+	m_bytesLoading -= bytesAdded;
+	if (!decoded) {
+		// keeps what it has, file won't get better
+		g_stateCache.DeleteTexture(texture);
+		rTexture.m_failed = true;
+		return;
+	}
+	g_stateCache.DeleteTexture(rTexture.m_texture);
+	m_bytesResident += bytesAdded;
+	rTexture.m_texture = texture;
+	rTexture.m_levelResident = levelFirst;
+	rTexture.m_generation++;
+}
+
+GLU TextureFromFile(const Path& directory, const char* pathRelativeFile, bool generateMipMap) {
+	Path path(directory);
+	path.concat(pathRelativeFile);
+	Image image = DecodeImage(path);
+	const GLU texture = TextureFromImage(image, path, generateMipMap);
+	FreeImage(image);
+	return texture;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+#include <glad/glad.h>		// OGL stuff
+
+#include "types.h"
+#include "UploadManager.h"	// UploadManager
+#include "JobSystem.h"		// JobSystem::Counter
+
+#include <array>			// std::array
+#include <filesystem>		// std::filesystem::path
+#include <vector>			// std::vector
+
+using Path = std::filesystem::path;
+
+// Streams mips of textures under VRAM budget, driven by feedback of geometry pass.
+// Texture holds only its resident levels: level 0 of its OGL texture is level m_levelResident of full chain.
+// Raising residency decodes file in background job into new, bigger texture (resident levels are copied on GPU)
+// and swaps to it once copies from staging memory are issued, dropping it copies remaining levels into
+// smaller texture right away. Levels of at most kMaxSizeTail texels are never dropped.
+// Immutable storage keeps every allocated level in memory whatever GL_TEXTURE_BASE_LEVEL is,
+// hence reallocation (sparse textures would avoid copies, but aren't supported widely enough).
+// Geometry pass writes smallest UV footprint of pixel per feedback slot (textures of one material)
+// into small buffer, which is read back a few frames later and turned into wanted level of each texture.
+class TextureStreamer
+{
+public:
+	// picks color of placeholder shown until first levels stream in
+	enum class Role : U32 { DIFFUSE, SPECULAR, NORMAL };
+
+	static constexpr U32 kMaxSizeTail = 64;
+	static constexpr U32 kMaxFeedbackSlots = 1024;
+	static constexpr GLI kLocationIdxFeedback = 0;	// explicit uniform location in geometry.frag
+	static constexpr GLU kBindingFeedback = 5;		// shader storage binding in geometry.frag
+
+	// rUploadManager has to outlive streamer, budget in bytes
+	TextureStreamer(UploadManager& rUploadManager, Size budget);
+	~TextureStreamer();
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// reads only header of image file, CPU only, so it can run in job
+	static Bool ReadHeader(const Path& path, int& rWidth, int& rHeight, int& rNumChannels);
+
+	// before first Update(), texture starts as 1x1 placeholder, which stays when number of channels isn't supported
+	// (0 for files which failed to load)
+	U32 Add(const Path& path, int width, int height, int numChannels, Role role);
+	// textures sampled by draws which write feedback with returned index, before first Update()
+	U32 AddFeedbackSlot(const std::vector<U32>& rAIdTexture);
+	U32 GetNumFeedbackSlots() const { return U32(m_aTextureOfSlot.size()); }
+	const std::vector<U32>& GetTexturesOfSlot(U32 idxSlot) const { return m_aTextureOfSlot[idxSlot]; }
+
+	// name changes with residency, so fetch it right before binding
+	GLU GetTexture(U32 idTexture) const { return m_aTexture[idTexture].m_texture; }
+	// counts changes of resident levels (placeholder replaced, levels loaded or dropped), for caches of what was drawn
+	U64 GetGeneration(U32 idTexture) const { return m_aTexture[idTexture].m_generation; }
+
+	// render thread, once per frame: applies feedback, drops levels when over budget and starts loads
+	void Update();
+	// render thread, around draws with feedback
+	void BeginFeedback() const;
+	void EndFeedback();
+	// waits for decoding and issues its copies, staging memory has to be still mapped
+	void Finish();
+
+	// resident and wanted memory, loads in flight
+	void PrintStats() const;
+
+private:
+	static constexpr U32 kNumReadbacks = 3;
+	// wanted level stays that long after last request, feedback covers only one pixel of 8x8 per frame
+	static constexpr U64 kFramesKeepWanted = 120;
+
+	struct Texture {
+		Path m_path;
+		int m_width;
+		int m_height;
+		int m_numChannels;
+		GLE m_format;
+		GLE m_internalFormat;
+		U32 m_numLevels;
+		U32 m_levelTail;		// first of never dropped levels
+		U32 m_levelFinest;		// finest level which fits into staging memory together with coarser ones
+		GLU m_texture;
+		U32 m_levelResident;	// m_numLevels when m_texture is placeholder
+		U32 m_levelWanted;
+		U64 m_frameWanted = 0;
+		U64 m_generation = 0;
+		Bool m_loading = false;
+		Bool m_failed = false;
+	};
+
+	// of resident levels [levelFirst, m_numLevels), RGB counts as RGBA, drivers pad it
+	static Size GetSizeVram(const Texture& rTexture, U32 levelFirst);
+	// levels [levelFirst, levelEnd) in staging memory, tightly packed
+	static Size GetSizeStaging(const Texture& rTexture, U32 levelFirst, U32 levelEnd);
+
+	U32 GetLevelWanted(const Texture& rTexture) const;
+	void ApplyFeedback();
+	// new texture with levels [levelFirst, m_numLevels), resident ones copied from old
+	GLU CreateWithResidentLevels(const Texture& rTexture, U32 levelFirst) const;
+	void DropLevels(U32 idTexture, U32 levelFirst);
+	// of textures which have more resident than wanted
+	void DropUnwantedLevels();
+	Bool StartLoad(U32 idTexture, U32 levelFirst);
+	// on render thread, after copies of load are issued
+	void FinishLoad(U32 idTexture, GLU texture, U32 levelFirst, Bool decoded);
+
+	UploadManager* m_pUploadManager;
+	Size m_budget;
+	std::vector<Texture> m_aTexture;
+	std::vector<std::vector<U32>> m_aTextureOfSlot;
+	Size m_bytesResident = 0;
+	Size m_bytesLoading = 0;	// resident after loads in flight finish
+	U64 m_frame = 0;
+	JobSystem::Counter m_counterDecoding{ 0 };
+
+	GLU m_bufFeedback = 0;
+	std::array<GLU, kNumReadbacks> m_aBufReadback = {};
+	std::array<const U32*, kNumReadbacks> m_aMappedReadback = {};
+	std::array<GLsync, kNumReadbacks> m_aFence = {};
+	U32 m_idxReadback = 0;
+	std::vector<U32> m_aFootprint;	// last read back, encoded like in geometry.frag
+	Bool m_hasFeedback = false;
+};
+
+// whole texture at once, for textures which aren't streamed
+GLU TextureFromFile(const Path& directory, const char* pathRelativeFile, bool generateMipMap = true);
\ No newline at end of file
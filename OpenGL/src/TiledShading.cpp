@@ -0,0 +1,77 @@
+#include "TiledShading.h"
+
+#include <array>		// std::array
+
+namespace {
+	// defines of shading.gl per kernel
+	const std::array<const Char*, U32(TiledShading::Kernel::COUNT)> kADefinesKernel = {
+		"#define SKY",
+		"#define SHADOW_LIT\n#define NO_AO",
+		"#define SHADOW_LIT",
+		"#define SHADOW_UMBRA\n#define NO_AO",
+		"#define SHADOW_UMBRA",
+		"#define NO_AO",
+		"",
+	};
+}
+
+TiledShading::TiledShading(U32 width, U32 height)
+	: m_passClassify("shadingClassify.comp"), m_width(width), m_height(height)
+{
+	const U32 wTiles = (width + kSizeTile - 1) / kSizeTile;
+	const U32 hTiles = (height + kSizeTile - 1) / kSizeTile;
+	m_numTiles = wTiles * hTiles;
+
+	m_aKernel.reserve(kNumKernels);
+	for (U32 i = 0; i < kNumKernels; i++) {
+		m_aKernel.push_back(Shader::Compute("shading.comp", kADefinesKernel[i]));
+		m_aKernel.back().SetUInt("IdxKernel", i);
+		m_aKernel.back().SetUInt("NumTiles", m_numTiles);
+	}
+	m_passClassify.SetUInt("NumTiles", m_numTiles);
+
+	// every tile can go to every kernel
+	glCreateBuffers(1, &m_bufTile);
+	glNamedBufferStorage(m_bufTile, kNumKernels * m_numTiles * sizeof(U32), nullptr, 0);
+	std::array<DispatchIndirectCommand, kNumKernels> aDispatch;
+	aDispatch.fill({ 0, 1, 1 });
+	glCreateBuffers(1, &m_bufDispatchReset);
+	glNamedBufferStorage(m_bufDispatchReset, sizeof(aDispatch), aDispatch.data(), 0);
+	glCreateBuffers(1, &m_bufDispatch);
+	glNamedBufferStorage(m_bufDispatch, sizeof(aDispatch), aDispatch.data(), 0);
+}
+
+TiledShading::~TiledShading() {
+	glDeleteBuffers(1, &m_bufDispatch);
+	glDeleteBuffers(1, &m_bufDispatchReset);
+	glDeleteBuffers(1, &m_bufTile);
+}
+
+TiledShading::Uniforms TiledShading::GetUniforms(Kernel kernel) {
+	Uniforms uniforms;
+	uniforms.m_surface = kernel != Kernel::SKY;
+	uniforms.m_sun = uniforms.m_surface && kernel != Kernel::UMBRA && kernel != Kernel::UMBRA_AO;
+	uniforms.m_ao = kernel == Kernel::LIT_AO || kernel == Kernel::UMBRA_AO || kernel == Kernel::PENUMBRA_AO;
+	return uniforms;
+}
+
+void TiledShading::Shade(GLU color, GLU diffuseLight, Bool enableAO) {
+	glCopyNamedBufferSubData(m_bufDispatchReset, m_bufDispatch, 0, 0, kNumKernels * sizeof(DispatchIndirectCommand));
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_bufTile);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_bufDispatch);
+	m_passClassify.SetBool("EnableAO", enableAO);
+	m_passClassify.Use();
+	glDispatchCompute((m_width + kSizeTile - 1) / kSizeTile, (m_height + kSizeTile - 1) / kSizeTile, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	glBindImageTexture(0, color, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glBindImageTexture(1, diffuseLight, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_bufDispatch);
+	for (U32 i = 0; i < kNumKernels; i++) {
+		m_aKernel[i].Use();
+		glDispatchComputeIndirect(i * sizeof(DispatchIndirectCommand));
+	}
+	// mips of diffuse light are generated, color is tone mapped through sampler
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
\ No newline at end of file
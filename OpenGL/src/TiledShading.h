@@ -0,0 +1,56 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Shader.h"		// Shader
+
+#include <vector>		// std::vector
+
+// Compute alternative to shading.frag: classification pass sorts kSizeTile x kSizeTile tiles of screen by what their
+// pixels need (only sky, sun fully lit, fully shadowed or penumbra, ambient occlusion or not) into lists
+// of kernels specialized for it (variants of shading.comp), which are then dispatched indirectly over their tiles,
+// so tiles without penumbra skip shadow filter, sky tiles do no shading at all.
+class TiledShading
+{
+public:
+	// order as in shadingClassify.comp
+	enum class Kernel : U32 { SKY, LIT, LIT_AO, UMBRA, UMBRA_AO, PENUMBRA, PENUMBRA_AO, COUNT };
+	static constexpr U32 kSizeTile = 16;	// work group of both passes
+
+	// uniforms of shading.frag a kernel declares, defines of the rest compile them out
+	struct Uniforms {
+		Bool m_surface = true;	// all but ColorSky
+		Bool m_sun = true;		// WsDirLight, ColorDirLight
+		Bool m_ao = true;		// EnableAO, LayoutGtao
+	};
+	static Uniforms GetUniforms(Kernel kernel);
+
+	TiledShading(U32 width, U32 height);
+	~TiledShading();
+	TiledShading(const TiledShading&) = delete;
+	TiledShading& operator=(const TiledShading&) = delete;
+
+	// take uniforms of shading.frag given by GetUniforms()
+	const std::vector<Shader>& GetKernels() const { return m_aKernel; }
+	// textures and samplers of shading.frag have to be bound (and lights of ClusteredLights),
+	// writes what it would into color and level 0 of diffuseLight
+	void Shade(GLU color, GLU diffuseLight, Bool enableAO);
+
+private:
+	struct DispatchIndirectCommand {
+		U32 m_numGroupsX;
+		U32 m_numGroupsY;
+		U32 m_numGroupsZ;
+	};
+
+	static constexpr U32 kNumKernels = U32(Kernel::COUNT);
+
+	Shader m_passClassify;
+	std::vector<Shader> m_aKernel;
+	U32 m_width;
+	U32 m_height;
+	U32 m_numTiles;
+	GLU m_bufTile = 0;				// region of m_numTiles per kernel
+	GLU m_bufDispatchReset = 0;		// no tiles, one group in y and z
+	GLU m_bufDispatch = 0;
+};
\ No newline at end of file
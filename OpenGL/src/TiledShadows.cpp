@@ -0,0 +1,40 @@
+#include "TiledShadows.h"
+
+TiledShadows::TiledShadows(U32 width, U32 height) {
+	m_aPass.reserve(2);
+	m_aPass.push_back(Shader("shadowClassify.comp"));
+	m_aPass.push_back(Shader("shadowDeferred.comp"));
+
+	const U32 numTiles = ((width + kSizeTile - 1) / kSizeTile) * ((height + kSizeTile - 1) / kSizeTile);
+	glCreateBuffers(1, &m_bufTile);
+	glNamedBufferStorage(m_bufTile, numTiles * sizeof(U32), nullptr, 0);
+	const DispatchIndirectCommand dispatch = { 0, 1, 1 };
+	glCreateBuffers(1, &m_bufDispatchReset);
+	glNamedBufferStorage(m_bufDispatchReset, sizeof(dispatch), &dispatch, 0);
+	glCreateBuffers(1, &m_bufDispatch);
+	glNamedBufferStorage(m_bufDispatch, sizeof(dispatch), &dispatch, 0);
+}
+
+TiledShadows::~TiledShadows() {
+	glDeleteBuffers(1, &m_bufDispatch);
+	glDeleteBuffers(1, &m_bufDispatchReset);
+	glDeleteBuffers(1, &m_bufTile);
+}
+
+void TiledShadows::Evaluate(GLU shadow, U32 level, U32 width, U32 height) {
+	glCopyNamedBufferSubData(m_bufDispatchReset, m_bufDispatch, 0, 0, sizeof(DispatchIndirectCommand));
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_bufTile);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_bufDispatch);
+	glBindImageTexture(0, shadow, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8);
+	m_aPass[0].Use();
+	glDispatchCompute((width + kSizeTile - 1) / kSizeTile, (height + kSizeTile - 1) / kSizeTile, 1);
+	// penumbra tiles write their texels again, with the same values where classification did
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_bufDispatch);
+	m_aPass[1].Use();
+	glDispatchComputeIndirect(0);
+	// read by upsample or shading through samplers
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Shader.h"		// Shader
+
+#include <vector>		// std::vector
+
+// Compute alternative to shadowDeferred.frag: classification pass looks every texel of target up in min/max pyramid
+// of shadow map (ShadowMapMinMax), writes fully lit and fully shadowed ones right away and lists kSizeTile x kSizeTile
+// tiles left with penumbra, only those then run blocker search and filter of PCSS, dispatched indirectly.
+class TiledShadows
+{
+public:
+	static constexpr U32 kSizeTile = 8;	// work group of both passes
+
+	// largest target
+	TiledShadows(U32 width, U32 height);
+	~TiledShadows();
+	TiledShadows(const TiledShadows&) = delete;
+	TiledShadows& operator=(const TiledShadows&) = delete;
+
+	// take uniforms of shadowDeferred.frag, except filter ones where IsFiltering() is false
+	const std::vector<Shader>& GetPasses() const { return m_aPass; }
+	// classification compiles out WidthLight, RadRotationTemporal and EnableEvsm
+	static Bool IsFiltering(U32 idxPass) { return idxPass != 0; }
+	// textures and samplers of shadowDeferred.frag have to be bound, writes what it would into level of R8 shadow
+	void Evaluate(GLU shadow, U32 level, U32 width, U32 height);
+
+private:
+	struct DispatchIndirectCommand {
+		U32 m_numGroupsX;
+		U32 m_numGroupsY;
+		U32 m_numGroupsZ;
+	};
+
+	std::vector<Shader> m_aPass;	// classification, penumbra
+	GLU m_bufTile = 0;
+	GLU m_bufDispatchReset = 0;		// no tiles, one group in y and z
+	GLU m_bufDispatch = 0;
+};
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "UploadManager.h"
+#include "Profiler.h"	// ProfileScope
+
+#include <cassert>		// assert
+#include <thread>		// std::this_thread::yield
+
+UploadManager::Copy UploadManager::CopyToBuffer(GLU buffer, Size offsetDst, Size offsetSrc, Size size) {
+	Copy copy;
+	copy.m_dst = buffer;
+	copy.m_offsetSrc = offsetSrc;
+	copy.m_size = size;
+	copy.m_offsetDst = offsetDst;
+	return copy;
+}
+
+UploadManager::Copy UploadManager::CopyToTexture(GLU texture, GLI level, GLS width, GLS height, GLE format, Size offsetSrc, Size size) {
+	Copy copy;
+	copy.m_dst = texture;
+	copy.m_toTexture = true;
+	copy.m_offsetSrc = offsetSrc;
+	copy.m_size = size;
+	copy.m_level = level;
+	copy.m_width = width;
+	copy.m_height = height;
+	copy.m_format = format;
+	return copy;
+}
+
+UploadManager::UploadManager(Size sizeRing, Size bytesPerFrame)
+	: m_sizeRing(sizeRing), m_bytesPerFrame(bytesPerFrame)
+{
+	// coherent, so writes of other threads are visible to copies issued after Commit() without explicit flushes
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, m_sizeRing, nullptr, flags);
+	m_pMapped = static_cast<U8*>(glMapNamedBufferRange(m_buffer, 0, m_sizeRing, flags));
+}
+
+UploadManager::~UploadManager() {
+	for (GLsync fence : m_aFence)
+		glDeleteSync(fence);
+	glUnmapNamedBuffer(m_buffer);
+	glDeleteBuffers(1, &m_buffer);
+}
+
+Bool UploadManager::TryAllocate(Size size, Allocation& rAllocation) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return TryAllocateLocked(size, rAllocation);
+}
+
+UploadManager::Allocation UploadManager::Allocate(Size size) {
+	assert(size <= m_sizeRing && "allocation doesn't fit into staging ring");
+	Allocation allocation;
+	while (true) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (TryAllocateLocked(size, allocation))
+			return allocation;
+		IssueLocked(~Size(0));
+		if (!m_aFence.empty()) {
+			glClientWaitSync(m_aFence.front(), GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			ReclaimLocked();
+		} else {
+			// the rest is being written by other threads
+			lock.unlock();
+			std::this_thread::yield();
+		}
+	}
+}
+
+void UploadManager::Commit(const Allocation& rAllocation, std::vector<Copy> aCopy, std::function<void()> onIssued) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_aCommitted.push_back({ rAllocation.m_id, rAllocation.m_offset, std::move(aCopy), std::move(onIssued) });
+}
+
+void UploadManager::Update() {
+	ProfileScope profile("upload: issue copies");
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ReclaimLocked();
+	IssueLocked(m_bytesPerFrame);
+}
+
+void UploadManager::Flush() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	IssueLocked(~Size(0));
+}
+
+Bool UploadManager::TryAllocateLocked(Size size, Allocation& rAllocation) {
+	size = (size + kAlignment - 1) / kAlignment * kAlignment;
+	if (m_numBytesUsed == 0)
+		m_head = 0;
+	// live allocations are [tail, head) modulo size of ring
+	const Size tail = (m_head + m_sizeRing - m_numBytesUsed) % m_sizeRing;
+	Size offset;
+	Size padding = 0;
+	if (m_numBytesUsed == 0 || tail < m_head) {
+		if (m_head + size <= m_sizeRing) {
+			offset = m_head;
+		} else if (size <= tail) {
+			// skip the end of ring, it's freed together with this allocation
+			offset = 0;
+			padding = m_sizeRing - m_head;
+		} else {
+			return false;
+		}
+	} else {
+		if (m_head + size > tail)
+			return false;
+		offset = m_head;
+	}
+
+	rAllocation.m_id = m_idEntryFront + m_aEntry.size();
+	rAllocation.m_offset = offset;
+	rAllocation.m_pData = m_pMapped + offset;
+	m_aEntry.push_back({ padding + size, kNotIssued });
+	m_numBytesUsed += padding + size;
+	m_head = (offset + size) % m_sizeRing;
+	return true;
+}
+
+void UploadManager::IssueLocked(Size budget) {
+	if (m_aCommitted.empty())
+		return;
+	// texture copies read from bound unpack buffer, rows of mips smaller than 4 texels aren't 4 byte aligned
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	Size numBytes = 0;
+	while (!m_aCommitted.empty() && numBytes < budget) {
+		const Committed& rCommitted = m_aCommitted.front();
+		for (const Copy& rCopy : rCommitted.m_aCopy) {
+			const Size offsetSrc = rCommitted.m_offset + rCopy.m_offsetSrc;
+			if (rCopy.m_toTexture)
+				glTextureSubImage2D(rCopy.m_dst, rCopy.m_level, 0, 0, rCopy.m_width, rCopy.m_height, rCopy.m_format, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offsetSrc));
+			else
+				glCopyNamedBufferSubData(m_buffer, rCopy.m_dst, offsetSrc, rCopy.m_offsetDst, rCopy.m_size);
+			numBytes += rCopy.m_size;
+		}
+		if (rCommitted.m_onIssued)
+			rCommitted.m_onIssued();
+		m_aEntry[rCommitted.m_id - m_idEntryFront].m_idBatch = m_idBatchFront + m_aFence.size();
+		m_aCommitted.pop_front();
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_aFence.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+void UploadManager::ReclaimLocked() {
+	// fences signal in order of submission
+	while (!m_aFence.empty() && glClientWaitSync(m_aFence.front(), 0, 0) != GL_TIMEOUT_EXPIRED) {
+		glDeleteSync(m_aFence.front());
+		m_aFence.pop_front();
+		m_idBatchFront++;
+	}
+	// allocations are freed in order of allocation, even if they were committed out of order
+	while (!m_aEntry.empty() && m_aEntry.front().m_idBatch < m_idBatchFront) {
+		m_numBytesUsed -= m_aEntry.front().m_sizeSpan;
+		m_aEntry.pop_front();
+		m_idEntryFront++;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+
+#include <deque>		// std::deque
+#include <functional>	// std::function
+#include <mutex>		// std::mutex
+#include <vector>		// std::vector
+
+// Uploads through persistently mapped, coherent staging ring buffer.
+// Any thread allocates staging memory and writes texels or vertices straight into it, then commits copies
+// (buffer to buffer or buffer to texture) for that memory. Render thread issues committed copies in order,
+// up to byte budget per frame, and fences them, memory is reused once GPU is done with them.
+class UploadManager
+{
+public:
+	struct Allocation {
+		U64 m_id = 0;
+		Size m_offset = 0;		// in staging buffer, sources of copies are relative to it
+		U8* m_pData = nullptr;	// write only, mapping is write combined so reads are very slow
+	};
+
+	struct Copy {
+		GLU m_dst = 0;			// buffer or texture
+		Bool m_toTexture = false;
+		Size m_offsetSrc = 0;	// relative to allocation
+		Size m_size = 0;
+		Size m_offsetDst = 0;	// buffer only
+		GLI m_level = 0;		// texture only, tightly packed rows
+		GLS m_width = 0;
+		GLS m_height = 0;
+		GLE m_format = GL_RGBA;
+	};
+
+	static Copy CopyToBuffer(GLU buffer, Size offsetDst, Size offsetSrc, Size size);
+	static Copy CopyToTexture(GLU texture, GLI level, GLS width, GLS height, GLE format, Size offsetSrc, Size size);
+
+	UploadManager(Size sizeRing, Size bytesPerFrame);
+	~UploadManager();
+	UploadManager(const UploadManager&) = delete;
+	UploadManager& operator=(const UploadManager&) = delete;
+
+	Size GetSizeRing() const { return m_sizeRing; }
+
+	// thread safe, false when there is no contiguous free space for now
+	Bool TryAllocate(Size size, Allocation& rAllocation);
+	// render thread only, flushes and waits for copies in flight until there is space
+	Allocation Allocate(Size size);
+	// thread safe, every allocation has to be committed (even without copies) to be reused,
+	// onIssued runs on render thread right after the copies are issued, so commands recorded from it
+	// (e.g. binding of texture being uploaded) see them, manager is locked then, so it can't call it back
+	void Commit(const Allocation& rAllocation, std::vector<Copy> aCopy, std::function<void()> onIssued = nullptr);
+
+	// render thread, once per frame: issues committed copies up to budget and reclaims finished ones
+	void Update();
+	// render thread, issues all committed copies
+	void Flush();
+
+private:
+	static constexpr Size kAlignment = 16;
+	static constexpr U64 kNotIssued = ~0ull;
+
+	struct Entry {
+		Size m_sizeSpan;		// with padding skipped at the end of ring
+		U64 m_idBatch;			// batch of copies it was issued with
+	};
+
+	struct Committed {
+		U64 m_id;
+		Size m_offset;
+		std::vector<Copy> m_aCopy;
+		std::function<void()> m_onIssued;
+	};
+
+	// require locked m_mutex
+	Bool TryAllocateLocked(Size size, Allocation& rAllocation);
+	void IssueLocked(Size budget);
+	void ReclaimLocked();
+
+	GLU m_buffer = 0;
+	U8* m_pMapped = nullptr;
+	Size m_sizeRing;
+	Size m_bytesPerFrame;
+
+	std::mutex m_mutex;
+	Size m_head = 0;
+	Size m_numBytesUsed = 0;
+	std::deque<Entry> m_aEntry;			// live allocations in ring order
+	U64 m_idEntryFront = 0;
+	std::deque<Committed> m_aCommitted;	// waiting for Update()
+	std::deque<GLsync> m_aFence;		// batches in flight
+	U64 m_idBatchFront = 0;
+};
\ No newline at end of file
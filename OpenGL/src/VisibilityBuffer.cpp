@@ -0,0 +1,113 @@
+#include "VisibilityBuffer.h"
+#include "GBuffer.h"		// GBuffer
+#include "Model.h"			// Model
+#include "StateCache.h"		// g_stateCache
+#include "error.h"			// PrintErrorAndAbort
+
+#include <algorithm>			// std::max
+#include <cassert>			// assert
+
+namespace {
+	constexpr U32 kSizeTile = 8;	// work group of both passes
+}
+
+VisibilityBuffer::VisibilityBuffer(U32 width, U32 height, U32 numMaterials)
+	: m_passClassify("visibilityClassify.comp"), m_passMaterial("visibilityMaterial.comp"),
+	  m_width(width), m_height(height), m_numMaterials(numMaterials)
+{
+	assert(numMaterials <= kMaxMaterials && "increase kMaxMaterials (and mask in visibilityClassify.comp)");
+	const U32 wTiles = (width + kSizeTile - 1) / kSizeTile;
+	const U32 hTiles = (height + kSizeTile - 1) / kSizeTile;
+	m_numTiles = wTiles * hTiles;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+	glTextureStorage2D(m_texture, 1, GL_R32UI, width, height);
+	glCreateFramebuffers(1, &m_fbo);
+	glNamedFramebufferTexture(m_fbo, GL_COLOR_ATTACHMENT0, m_texture, 0);
+	if (glCheckNamedFramebufferStatus(m_fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		PrintErrorAndAbort("Framebuffer not complete!");
+
+	glCreateBuffers(1, &m_bufDraw);
+	glNamedBufferStorage(m_bufDraw, kMaxDraws * sizeof(Draw), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	// every tile can hold every material
+	glCreateBuffers(1, &m_bufTile);
+	glNamedBufferStorage(m_bufTile, Size(std::max(numMaterials, 1u)) * m_numTiles * sizeof(U32), nullptr, 0);
+	const std::vector<DispatchIndirectCommand> aDispatchReset(std::max(numMaterials, 1u), { 0, 1, 1 });
+	const Size sizeDispatches = aDispatchReset.size() * sizeof(DispatchIndirectCommand);
+	glCreateBuffers(1, &m_bufDispatchReset);
+	glNamedBufferStorage(m_bufDispatchReset, sizeDispatches, aDispatchReset.data(), 0);
+	glCreateBuffers(1, &m_bufDispatch);
+	glNamedBufferStorage(m_bufDispatch, sizeDispatches, aDispatchReset.data(), 0);
+}
+
+VisibilityBuffer::~VisibilityBuffer() {
+	glDeleteBuffers(1, &m_bufDispatch);
+	glDeleteBuffers(1, &m_bufDispatchReset);
+	glDeleteBuffers(1, &m_bufTile);
+	glDeleteBuffers(1, &m_bufDraw);
+	glDeleteFramebuffers(1, &m_fbo);
+	g_stateCache.DeleteTexture(m_texture);
+}
+
+void VisibilityBuffer::Begin(GLU depth) {
+	m_aDraw.clear();
+	g_stateCache.BindFramebuffer(m_fbo);
+	glNamedFramebufferTexture(m_fbo, GL_DEPTH_ATTACHMENT, depth, 0);
+	const U32 none = kNone;
+	glClearTexImage(m_texture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &none);
+}
+
+void VisibilityBuffer::SetDraw(U32 firstIndex, U32 baseVertex, U32 idxMaterial) {
+	AddDraw({ firstIndex, I32(baseVertex), kNone, idxMaterial });
+}
+
+void VisibilityBuffer::SetDrawIndirect(U32 idxCommand, U32 idxMaterial) {
+	AddDraw({ 0, 0, idxCommand, idxMaterial });
+}
+
+void VisibilityBuffer::AddDraw(const Draw& rDraw) {
+	assert(m_aDraw.size() < kMaxDraws && "too many draws, decrease kBitsTriangle");
+	assert(rDraw.m_idxMaterial < m_numMaterials);
+	glUniform1ui(kLocationIdDraw, U32(m_aDraw.size()) << kBitsTriangle);
+	m_aDraw.push_back(rDraw);
+}
+
+void VisibilityBuffer::Resolve(const Model& rModel, const GBuffer& rGBuffer) {
+	if (m_aDraw.empty())
+		return;
+	const GeometryPool& rPool = rModel.GetGeometryPool();
+	const MeshletCuller& rCuller = rModel.GetMeshletCuller();
+	glNamedBufferSubData(m_bufDraw, 0, m_aDraw.size() * sizeof(Draw), m_aDraw.data());
+	glCopyNamedBufferSubData(m_bufDispatchReset, m_bufDispatch, 0, 0, m_numMaterials * sizeof(DispatchIndirectCommand));
+	// ids written by draws, commands written by meshlet culling
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glBindImageTexture(0, m_texture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_bufDraw);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_bufTile);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_bufDispatch);
+	m_passClassify.SetUInt("NumTiles", m_numTiles);
+	m_passClassify.Use();
+	glDispatchCompute((m_width + kSizeTile - 1) / kSizeTile, (m_height + kSizeTile - 1) / kSizeTile, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	glBindImageTexture(1, rGBuffer.GetDiffuseSpec(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	glBindImageTexture(2, rGBuffer.GetNormal(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GBuffer::GetFormatNormal(rGBuffer.GetLayout()));
+	glBindImageTexture(3, rGBuffer.GetVelocity(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, rPool.GetIndexBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, rCuller.GetIndexCulledBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, rCuller.GetCommandBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, rPool.GetPositionBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, rPool.GetAttributesBuffer());
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_bufDispatch);
+	m_passMaterial.SetUInt("NumTiles", m_numTiles);
+	m_passMaterial.SetBool("Index16", rPool.GetIndexType() == GL_UNSIGNED_SHORT);
+	m_passMaterial.Use();
+	for (U32 i = 0; i < m_numMaterials; i++) {
+		m_passMaterial.SetUInt("IdxMaterial", i);
+		rModel.BindMaterialTextures(i);
+		glDispatchComputeIndirect(i * sizeof(DispatchIndirectCommand));
+	}
+	// G-buffer is read by following passes through samplers
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
\ No newline at end of file
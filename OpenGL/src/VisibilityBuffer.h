@@ -0,0 +1,77 @@
+#pragma once
+#include <glad/glad.h>	// OGL stuff
+
+#include "types.h"
+#include "Shader.h"		// Shader
+
+#include <vector>		// std::vector
+
+class GBuffer;
+class Model;
+
+// Alternative to geometry pass: draws write only depth and 32 bit id of closest surface,
+// (draw << kBitsTriangle) | gl_PrimitiveID, so overdraw costs no texture sampling nor G-buffer writes.
+// Resolve() then classifies 8x8 tiles by materials of their pixels and runs material pass per material
+// over its tiles, which refetches triangles from shared vertex and index buffers (or culled ones of indirect draws),
+// interpolates them with barycentrics and their derivatives and writes G-buffer for shading as geometry pass would.
+// Materials are feedback slots of texture streamer (one per material of model), material pass writes feedback too.
+class VisibilityBuffer
+{
+public:
+	static constexpr U32 kBitsTriangle = 20;	// triangles per draw, ids of draws take the rest
+	static constexpr U32 kNone = ~0u;			// id of pixel without geometry
+	static constexpr U32 kMaxDraws = (1 << (32 - kBitsTriangle)) - 1; // last id would collide with kNone
+	static constexpr U32 kMaxMaterials = 256;	// shared bit mask in visibilityClassify.comp
+	static constexpr GLI kLocationIdDraw = 1;	// explicit uniform location in visibility.frag
+
+	VisibilityBuffer(U32 width, U32 height, U32 numMaterials);
+	~VisibilityBuffer();
+	VisibilityBuffer(const VisibilityBuffer&) = delete;
+	VisibilityBuffer& operator=(const VisibilityBuffer&) = delete;
+
+	// binds framebuffer with depth attached and clears ids (not depth) and draws of last frame
+	void Begin(GLU depth);
+	// set id of next draw of current program, which has to write it (visibility.frag),
+	// firstIndex is absolute in shared index buffer, idxCommand is command of MeshletCuller
+	void SetDraw(U32 firstIndex, U32 baseVertex, U32 idxMaterial);
+	void SetDrawIndirect(U32 idxCommand, U32 idxMaterial);
+
+	// material pass sets the same uniforms as geometry pass: matrices, jitter, normal mapping and encoding, feedback
+	const Shader& GetPassMaterial() const { return m_passMaterial; }
+	// writes G-buffer of pixels covered by draws, other pixels keep what they were cleared to,
+	// texture streaming feedback and samplers of units 1 - 3 have to be bound
+	void Resolve(const Model& rModel, const GBuffer& rGBuffer);
+
+	GLU GetTexture() const { return m_texture; }
+
+private:
+	// std430 layout of Draw in visibilityMaterial.comp
+	struct Draw {
+		U32 m_firstIndex;
+		I32 m_baseVertex;
+		U32 m_idxCommand;	// kNone for direct draws
+		U32 m_idxMaterial;
+	};
+
+	struct DispatchIndirectCommand {
+		U32 m_numGroupsX;
+		U32 m_numGroupsY;
+		U32 m_numGroupsZ;
+	};
+
+	void AddDraw(const Draw& rDraw);
+
+	Shader m_passClassify;
+	Shader m_passMaterial;
+	U32 m_width;
+	U32 m_height;
+	U32 m_numMaterials;
+	U32 m_numTiles;
+	GLU m_texture = 0;
+	GLU m_fbo = 0;
+	std::vector<Draw> m_aDraw;
+	GLU m_bufDraw = 0;
+	GLU m_bufTile = 0;				// region of m_numTiles per material
+	GLU m_bufDispatchReset = 0;		// no tiles, one group in y and z
+	GLU m_bufDispatch = 0;
+};
\ No newline at end of file
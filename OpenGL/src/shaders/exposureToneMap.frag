@@ -6,12 +6,12 @@ in vec2 UV;
 layout(binding = 0) uniform sampler2D ColorHDR;
 layout(binding = 1) uniform sampler2D LogLuminance;
 layout(binding = 2) uniform sampler2D LogLuminanceAvg;
-layout(binding = 3) uniform sampler2DArray ShadowMapArray;
+layout(binding = 3) uniform sampler2D ShadowMap;
 
 uniform float Exposure;
 
 uniform bool ShowShadowMap;
-uniform uint IdxCascade;
+uniform vec4 RectShadowMap;	// offset and size of shown cascade in uv of atlas
 uniform bool ShowAO;
 
 uniform vec4 ParamsLottes;
@@ -50,7 +50,7 @@ vec3 LottesCrossTalk(vec3 rgb, vec4 abcd, float crossTalkCoefficient, float whit
 
 void main() {
 	if (ShowShadowMap) {
-		const vec3 color = texture(ShadowMapArray, vec3(UV, IdxCascade)).rrr;
+		const vec3 color = texture(ShadowMap, RectShadowMap.xy + UV * RectShadowMap.zw).rrr;
 		outColor = vec4(color, 1);
 	} else if (ShowAO) {
 		const vec3 color = texture(ColorHDR, UV).rrr;
@@ -1,9 +1,14 @@
-#version 420 core
+#version 430 core
 #include "normals.gl"
 #include "gamma.gl"
+#include "feedback.gl"
 layout (location = 0) out vec4 outDiffuseSpec;
 layout (location = 1) out vec3 outNormal;
 layout (location = 2) out vec2 outVelocity;
+#ifndef ALPHA_MASKED
+// feedback writes would otherwise turn early depth test off
+layout (early_fragment_tests) in;
+#endif
 in VS_OUT {
 	vec3 PosCur;
 	vec3 PosPrev;
@@ -22,7 +27,11 @@ layout (binding = 4) uniform sampler2D Mask;
 uniform vec2 JitterCurr;
 uniform vec2 JitterPrev;
 
+layout (location = 0) uniform uint IdxFeedback;	// slot of material, see feedback.gl
+
 void main() {
+	// derivatives before discard, they are undefined in non uniform control flow
+	WriteFeedback(IdxFeedback, uvec2(gl_FragCoord.xy), dFdx(Input.UV), dFdy(Input.UV));
 	#ifdef ALPHA_MASKED
 	if (texture(Mask, Input.UV).a < .5)
 		discard;
@@ -32,7 +41,7 @@ void main() {
 	const float colorSpecular = texture(Specular, Input.UV).r;
 	const vec3 wsNormal = GetWsNormal(Input.WsNormal, Input.WsTangent, texture(Normal, Input.UV).rgb);
 	outDiffuseSpec = vec4(colorDiffuse, colorSpecular);
-	outNormal = wsNormal * 0.5 + 0.5;
+	outNormal = EncodeGBufferNormal(wsNormal);
 	outVelocity = (((Input.PosCur.xy / Input.PosCur.z) - JitterCurr)
 				- ((Input.PosPrev.xy / Input.PosPrev.z) - JitterPrev)) * 0.5;
 }
@@ -1,8 +1,8 @@
 #version 420 core
-layout (location = 0) in vec3 inPos;
+layout (location = 0) in vec3 inPos;		// unorm relative to model bounds, ModelViewProj dequantizes
 layout (location = 1) in vec3 inNormal;
-layout (location = 2) in vec2 inUV;
-layout (location = 3) in vec3 inTangent;
+layout (location = 2) in vec2 inUV;			// unorm, scaled by RangeUv
+layout (location = 3) in vec4 inTangent;	// w: sign of bitangent
 
 out VS_OUT {
 	vec3 PosCur;
@@ -15,11 +15,14 @@ out VS_OUT {
 uniform mat4 ModelViewProj;
 uniform mat4 ModelViewProjPrev;
 uniform mat3 NormalMatrix;
+uniform float RangeUv;
+// geometry pass after depth prepass (shadow.vert) tests for equal depth
+invariant gl_Position;
 
 void main() {
 	Output.WsNormal  = NormalMatrix*inNormal;
-	Output.WsTangent = NormalMatrix*inTangent;
-    Output.UV = inUV;
+	Output.WsTangent = NormalMatrix*(inTangent.xyz * inTangent.w);
+    Output.UV = inUV * RangeUv;
 	gl_Position = ModelViewProj * vec4(inPos, 1);
 	Output.PosCur = gl_Position.xyw;
 	Output.PosPrev = (ModelViewProjPrev * vec4(inPos, 1)).xyw;
@@ -1,17 +1,33 @@
 #version 430 core
 #include "kernels.gl"
 #include "depth.gl"
+#include "normals.gl"
+#include "gtao.gl"
+#include "interleave.gl"
 
-layout (location = 0) out float Ao;
+// ambient occlusion and bent normal, encoded by LayoutGtao
+layout (location = 0) out vec4 Gtao;
 
 in vec2 UV;
 
 layout (binding = 0) uniform sampler2D Depth;
+// x min (farthest), y max (closest), texel of level n covers 2^n texels of Depth
+layout (binding = 1) uniform sampler2D HiZ;
+// history of temporal denoiser and how converged it is, reprojected by velocity
+layout (binding = 2) uniform sampler2D Velocity;
+layout (binding = 3) uniform sampler2D DepthPrev;
+layout (binding = 4) uniform sampler2D SsaoAcc;
+layout (binding = 5) uniform sampler2D ConfidencePrev;
 
 uniform mat4 InvProj;
+uniform mat4 InvView;
 uniform float WsRadius;
 uniform vec4 Scaling;
 uniform float RadRotationTemporal;
+uniform int NumLevelsHiZ;
+// fewer steps where history is converged, half as often as Interleave says
+uniform bool Adaptive;
+uniform float Near;
 const float kPi = 3.141592653589793238;
 
 vec3 VsPosFromCsDepth(sampler2D Depth, vec2 uv, mat4 invProj) {
@@ -27,6 +43,18 @@ vec3 VsPosFromCsDepth(sampler2D Depth, vec2 uv, mat4 invProj) {
 	return vsPos.xyz / vsPos.w;
 } 
 
+// samples spaced further apart than a few texels read farthest depth of coarser Hi-Z level instead, which keeps large
+// radii cache friendly at the cost of occlusion: thin near occluders within footprint of texel are dropped, so large
+// steps under-occlude (like farthest depth of downsampling, it also avoids halos)
+vec3 VsPosFromHiZ(vec2 uv, float texelsStep, mat4 invProj) {
+	const int level = min(int(log2(max(texelsStep, 1))) - 1, NumLevelsHiZ - 1);
+	if (level <= 0)
+		return VsPosFromCsDepth(Depth, uv, invProj);
+	const ivec2 texel = clamp(ivec2(uv * Scaling.xy), ivec2(0), ivec2(Scaling.xy) - 1) >> level;
+	const vec4 vsPos = invProj * vec4(uv * 2 - 1, texelFetch(HiZ, texel, level).x, 1);
+	return vsPos.xyz / vsPos.w;
+}
+
 vec3 VsNormalFromDepth(sampler2D Depth, vec2 uv, float depthCenter, vec3 vsCenterPos, vec2 scaling) {
 	const vec2 up	 = vec2(0, scaling.y);
 	const vec2 right = vec2(scaling.x, 0);
@@ -62,11 +90,24 @@ vec3 VsNormalFromDepth(sampler2D Depth, vec2 uv, float depthCenter, vec3 vsCente
 void main() {
 	const float csDepth = texture(Depth, UV).x;
 	const vec3 vsCenterPos = VsPosFromCsDepth(csDepth, UV, InvProj);
+	const ivec2 xy = ivec2(gl_FragCoord);
+
+	const vec2 uvPrev = UV - texture(Velocity, UV).xy;
+	// confidence of history (see gtaoTemporalDenoiser.frag), 0 off screen and where it was occluded as temporal
+	// denoiser finds it, so disoccluded pixels get all steps
+	const bool validHistory = IsHistoryValid(DepthPrev, uvPrev, vsCenterPos.z, Near);
+	const float confidence = Adaptive && validHistory ? texture(ConfidencePrev, uvPrev).x : 0;
+	// history stands in for skipped cells, converged history for twice as many, temporal denoiser blends it as usual;
+	// 6 rotations of RadRotationTemporal are 3 directions of slice twice, cell gets all of them even every fourth frame
+	const int interleave = confidence == 1 ? min(2 * Interleave, 4) : Interleave;
+	if (validHistory && IsCellSkipped(xy, interleave)) {
+		Gtao = texture(SsaoAcc, uvPrev);
+		return;
+	}
 	const vec3 vsV = normalize(-vsCenterPos);
 	const vec3 vsNormal = VsNormalFromDepth(Depth, UV, csDepth, vsCenterPos, Scaling.zw);
 	const float radius = min(WsRadius / abs(vsCenterPos.z), WsRadius);
 
-	const ivec2 xy = ivec2(gl_FragCoord);
 	const float radAngle = RadRotationTemporal +
 		(1.0 / 16.0) * ((((xy.x+xy.y) & 0x3) << 2) + (xy.x & 0x3)) * kPi * 2;
 
@@ -79,17 +120,20 @@ void main() {
 	const float cosN = clamp(dot(vsProjectedNormal, vsV) / length(vsProjectedNormal), 0, 1);
 	const float n = signN * acos(cosN);
 
-	const int kNumDirectionSamples = 6;
-	const float ssStep = radius / kNumDirectionSamples;
+	// half of steps over the same radius once history is halfway converged, Hi-Z level follows longer step
+	const int numDirectionSamples = confidence >= 0.5 ? 3 : 6;
+	const float ssStep = radius / numDirectionSamples;
+	const float texelsStep = ssStep * length(direction.xy * Scaling.xy);
 	float ao = 0;
+	float aRadHorizon[2];
 	for (int side = 0; side <= 1; side++) {
 		float cosHorizon = -1;
 		vec2 uv = UV;
 		uv += (-1 + 2 * side) * direction.xy *
 			0.25 * ((xy.y - xy.x) & 0x3) * Scaling.zw;
-		for (int i = 0; i < kNumDirectionSamples; i++) {
+		for (int i = 0; i < numDirectionSamples; i++) {
 			uv += (-1 + 2 * side) * direction.xy * (ssStep);
-			const vec3 vsSamplePos = VsPosFromCsDepth(Depth, uv, InvProj);
+			const vec3 vsSamplePos = VsPosFromHiZ(uv, texelsStep, InvProj);
 			const vec3 vsHorizonVec = (vsSamplePos - vsCenterPos);
 			const float lenHorizonVec = length(vsHorizonVec);
 			const float cosHorizonCurrent =  dot(vsHorizonVec, vsV) / lenHorizonVec;
@@ -98,8 +142,13 @@ void main() {
 		}
 		const float radHorizon = n + clamp((-1 + 2*side) * acos(cosHorizon) - n, -kPi/2, kPi/2);
 		ao += length(vsProjectedNormal) * 0.25 * (cosN + 2 * radHorizon * sin(n) - cos(2 * radHorizon -n));
+		aRadHorizon[side] = radHorizon;
 	}
 
-	Ao = ao;
+	// bent normal from the same horizons: halfway between them in slice, angles go from view vector towards direction
+	// (Jimenez et al., Practical Real-Time Strategies for Accurate Indirect Occlusion), denoisers average slices
+	const float radBent = (aRadHorizon[0] + aRadHorizon[1]) / 2;
+	const vec3 vsBentNormal = vsV * cos(radBent) + normalize(orthoDirection) * sin(radBent);
+	Gtao = EncodeGtao(ao, normalize(mat3(InvView) * vsBentNormal));
 }
 
@@ -1,6 +1,8 @@
 #version 420 core
 #include "depth.gl"
-out float Ao;
+#include "normals.gl"
+#include "gtao.gl"
+out vec4 Gtao;
 
 in vec2 UV;
 
@@ -9,7 +11,7 @@ layout (binding = 1) uniform sampler2D Depth;
 
 uniform float Near;
 
-void main() {	
+void main() {
 	vec4[4] ao4s;
 	vec4[4] depth4s;
 	ao4s[0] = textureGather(Ssao, UV);
@@ -20,21 +22,31 @@ void main() {
 	depth4s[1] = textureGatherOffset(Depth, UV, ivec2(0,-2));
 	depth4s[2] = textureGatherOffset(Depth, UV, ivec2(-2,0));
 	depth4s[3] = textureGatherOffset(Depth, UV, ivec2(-2,-2));
-	
+
 	const float depthCurrent = VsDepthFromCsDepth(depth4s[0].w, Near);
 
+	vec4[4] weight4s;
 	float ao = 0;
 	float weight = 0;
 	const float threshold = abs(0.1 * depthCurrent);
 	for (int i = 0; i < 4; i++) {
 		for (int j = 0; j < 4; j++) {
 			const float depthDiff = abs(VsDepthFromCsDepth(depth4s[i][j], Near) - depthCurrent);
-			if (depthDiff < threshold) {
-				const float weightCurrent = 1. - clamp(10. * depthDiff / threshold, 0., 1.);
-				ao += ao4s[i][j] * weightCurrent;
-				weight += weightCurrent;
-			}
+			weight4s[i][j] = depthDiff < threshold ? 1. - clamp(10. * depthDiff / threshold, 0., 1.) : 0;
+			ao += ao4s[i][j] * weight4s[i][j];
+			weight += weight4s[i][j];
 		}
 	}
-	Ao = ao / weight;
-}
+
+	// bent normal with the same weights, gather of its channels per offset
+	vec3 bentNormal = vec3(0);
+	if (LayoutGtao != g_kLayoutGtaoScalar) {
+		bentNormal.x = dot(textureGather(Ssao, UV, 1), weight4s[0]) + dot(textureGatherOffset(Ssao, UV, ivec2(0,-2), 1), weight4s[1])
+			+ dot(textureGatherOffset(Ssao, UV, ivec2(-2,0), 1), weight4s[2]) + dot(textureGatherOffset(Ssao, UV, ivec2(-2,-2), 1), weight4s[3]);
+		bentNormal.y = dot(textureGather(Ssao, UV, 2), weight4s[0]) + dot(textureGatherOffset(Ssao, UV, ivec2(0,-2), 2), weight4s[1])
+			+ dot(textureGatherOffset(Ssao, UV, ivec2(-2,0), 2), weight4s[2]) + dot(textureGatherOffset(Ssao, UV, ivec2(-2,-2), 2), weight4s[3]);
+		bentNormal.z = dot(textureGather(Ssao, UV, 3), weight4s[0]) + dot(textureGatherOffset(Ssao, UV, ivec2(0,-2), 3), weight4s[1])
+			+ dot(textureGatherOffset(Ssao, UV, ivec2(-2,0), 3), weight4s[2]) + dot(textureGatherOffset(Ssao, UV, ivec2(-2,-2), 3), weight4s[3]);
+	}
+	Gtao = vec4(ao, bentNormal) / weight;
+}
\ No newline at end of file
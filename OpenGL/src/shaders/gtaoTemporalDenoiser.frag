@@ -1,6 +1,10 @@
 #version 420 core
 #include "depth.gl"
-out float Ao;
+#include "normals.gl"
+#include "gtao.gl"
+layout (location = 0) out vec4 Gtao;
+// how converged accumulation is, for adaptive sampling of gtao.frag
+layout (location = 1) out float Confidence;
 
 in vec2 UV;
 
@@ -9,13 +13,17 @@ layout (binding = 1) uniform sampler2D SsaoAcc;
 layout (binding = 2) uniform sampler2D Velocity;
 layout (binding = 3) uniform sampler2D DepthCurr;
 layout (binding = 4) uniform sampler2D DepthPrev;
+layout (binding = 5) uniform sampler2D ConfidencePrev;
 
 uniform float Near;
 uniform float RateOfChange;
 uniform vec2 Scaling;
 
+// frames of accepted history until it counts as converged
+const float kStepConfidence = 1.0 / 8;
+
 void main() {
-	const float ao		= texture(Ssao, UV).x;
+	const vec4 gtao		= texture(Ssao, UV);
 	const vec2 velocity	= texture(Velocity, UV.xy).xy;
 
 	// bilateral reprojection
@@ -25,6 +33,13 @@ void main() {
 	// calculate weight's for top left pixel (bilinearWeights[0]), then propagate for rest
 	const vec4 depthPrev4 = textureGather(DepthPrev, UV-velocity);
 	const vec4 aoAcc4	  = textureGather(SsaoAcc, UV-velocity);
+	// channels of bent normal, layout without it leaves them 0
+	vec4[3] bentNormalAcc4s = vec4[3](vec4(0), vec4(0), vec4(0));
+	if (LayoutGtao != g_kLayoutGtaoScalar) {
+		bentNormalAcc4s[0] = textureGather(SsaoAcc, UV-velocity, 1);
+		bentNormalAcc4s[1] = textureGather(SsaoAcc, UV-velocity, 2);
+		bentNormalAcc4s[2] = textureGather(SsaoAcc, UV-velocity, 3);
+	}
 
 	// small distortions are still visible on mouse movement (tested on Kepler)
 	const vec2 pixelUVPrev = (UV - velocity) * Scaling.xy - vec2(0.5) + vec2(1./512);
@@ -40,16 +55,17 @@ void main() {
 	const float depthCurr = texture(DepthCurr, UV).x;
 	const float vsDepthCurr = VsDepthFromCsDepth(depthCurr, Near);
 	float weight = 0;
-	float aoAccWeighted = 0;
+	vec4 gtaoAccWeighted = vec4(0);
 	for (int i = 0; i < 4; i++) {
 		const float vsDepthPrev = VsDepthFromCsDepth(depthPrev4[i], Near);
 		// too agresive bilateral results in floating AO under WSAD camera motion
 		// currently don't eliminate halo in 100%
 		const float bilateralWeight = clamp(1.0 + 0.1 * (vsDepthCurr - vsDepthPrev), 0.01, 1.0);
 		weight		  += bilinearWeights[i] * bilateralWeight;
-		aoAccWeighted += bilinearWeights[i] * bilateralWeight * aoAcc4[i];
+		const vec4 gtaoAcc = vec4(aoAcc4[i], bentNormalAcc4s[0][i], bentNormalAcc4s[1][i], bentNormalAcc4s[2][i]);
+		gtaoAccWeighted += bilinearWeights[i] * bilateralWeight * gtaoAcc;
 	}
-	aoAccWeighted /= weight;
+	gtaoAccWeighted /= weight;
 
 	float rateOfChange = RateOfChange;
 	const vec2 uvPrevDistanceToMiddle = abs((UV - velocity) - vec2(0.5));
@@ -75,5 +91,11 @@ void main() {
 	if ((-vsDepthCurr * 0.9) > -vsDepthPrev)
 		rateOfChange = 1;
 
-	Ao = mix(aoAccWeighted, ao, rateOfChange);
+	Gtao = mix(gtaoAccWeighted, gtao, rateOfChange);
+
+	// grows with every frame history is kept, history which disagrees with new sample isn't converged
+	float confidence = rateOfChange == 1 ? 0 : min(texture(ConfidencePrev, UV - velocity).x + kStepConfidence, 1);
+	if (abs(gtao.x - gtaoAccWeighted.x) > 0.1)
+		confidence = min(confidence, 0.25);
+	Confidence = confidence;
 }
@@ -1,16 +1,19 @@
 #version 330 core
-layout (location = 0) in vec3 inPos;
+layout (location = 0) in vec3 inPos;	// unorm relative to model bounds, ModelLightProj dequantizes
 #ifdef ALPHA_MASKED
-layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec2 inUV;		// unorm, scaled by RangeUv
 out vec2 UV;
+uniform float RangeUv;
 #endif
 
 uniform mat4 ModelLightProj;
+// depth prepass draws the same geometry as geometry.vert, which then tests for equal depth
+invariant gl_Position;
 
 void main()
 {
 #ifdef ALPHA_MASKED
-	UV = inUV;
+	UV = inUV * RangeUv;
 #endif
     gl_Position = ModelLightProj * vec4(inPos, 1.0);
 }
\ No newline at end of file
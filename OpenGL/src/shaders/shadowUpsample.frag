@@ -0,0 +1,54 @@
+#version 430 core
+// depth aware upsample of shadow which shadowDeferred.frag evaluated for every Downscale x Downscale block
+// of pixels at its lower left one: bilinear weights of 4 texels around pixel, texels whose pixel lies
+// on another surface (view depth differs too much) don't count, if none is left the closest one in depth is taken
+
+out float Shadow;
+
+layout (binding = 0) uniform sampler2D ShadowLowRes;
+layout (binding = 1) uniform sampler2D Depth;
+
+#include "depth.gl"
+
+uniform int Downscale;
+uniform int LevelLowRes;	// of ShadowLowRes
+// vied depth from clip depth
+uniform float Near;
+
+const float kToleranceDepth = 0.05;	// relative to view depth of pixel
+
+void main() {
+	const ivec2 pixel = ivec2(gl_FragCoord.xy);
+	const float csDepth = texelFetch(Depth, pixel, 0).r;
+	// sky
+	if (csDepth == 0) {
+		Shadow = 1;
+		return;
+	}
+	const float vsDepth = VsDepthFromCsDepth(csDepth, Near);
+	const ivec2 sizeLowRes = textureSize(ShadowLowRes, LevelLowRes);
+
+	const vec2 posLowRes = vec2(pixel) / Downscale;
+	const ivec2 texelBase = ivec2(posLowRes);
+	const vec2 fraction = posLowRes - texelBase;
+	float shadowAcc = 0;
+	float weightAcc = 0;
+	float shadowClosest = 1;
+	float diffClosest = 1e30;
+	for (int i = 0; i < 4; i++) {
+		const ivec2 offset = ivec2(i & 1, i >> 1);
+		const ivec2 texel = min(texelBase + offset, sizeLowRes - 1);
+		const float shadow = texelFetch(ShadowLowRes, texel, LevelLowRes).r;
+		const float csDepthTexel = texelFetch(Depth, texel * Downscale, 0).r;
+		const float diff = csDepthTexel == 0 ? 1e30 : abs(VsDepthFromCsDepth(csDepthTexel, Near) - vsDepth);
+		const vec2 bilinear = mix(1 - fraction, fraction, vec2(offset));
+		const float weight = bilinear.x * bilinear.y * clamp(1 - diff / (kToleranceDepth * abs(vsDepth)), 0, 1);
+		shadowAcc += shadow * weight;
+		weightAcc += weight;
+		if (diff < diffClosest) {
+			diffClosest = diff;
+			shadowClosest = shadow;
+		}
+	}
+	Shadow = weightAcc > 1e-4 ? shadowAcc / weightAcc : shadowClosest;
+}
\ No newline at end of file
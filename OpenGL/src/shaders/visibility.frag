@@ -0,0 +1,22 @@
+#version 430 core
+// visibility buffer (see VisibilityBuffer): draw and triangle of closest surface, nothing else
+// is written or sampled (alpha masked draws sample only mask), attributes are fetched by material pass
+layout (location = 0) out uint outIdVisibility;
+#ifndef ALPHA_MASKED
+layout (early_fragment_tests) in;
+#endif
+
+layout (location = 1) uniform uint IdDraw;	// already shifted above triangle bits
+
+#ifdef ALPHA_MASKED
+in vec2 UV;
+layout (binding = 0) uniform sampler2D Mask;
+#endif
+
+void main() {
+	#ifdef ALPHA_MASKED
+	if (texture(Mask, UV).a < 0.5)
+		discard;
+	#endif
+	outIdVisibility = IdDraw | uint(gl_PrimitiveID);
+}
\ No newline at end of file